@@ -26,6 +26,23 @@
 #define DISTRHO_PLUGIN_HAS_EMBED_UI    1
 #define DISTRHO_PLUGIN_HAS_EXTERNAL_UI 1
 #define DISTRHO_PLUGIN_IS_RT_SAFE      1
+#define DISTRHO_PLUGIN_WANT_STATE      1
+#define DISTRHO_PLUGIN_WANT_FULL_STATE 1
+
+/**
+ * The UI reads the DSP output for its waveform history, 48k samples a second.
+ * Neither parameters nor state can carry that, and DPF has no other way from
+ * DSP to UI. So the UI reaches the DSP's WaveformRing through the instance
+ * pointer. That ring, a lock-free single reader single writer queue, is all
+ * the two share; nothing else goes around parameters and state.
+ *
+ * Where UI and DSP do not share a process, the pointer is null and only the
+ * waveform history is missing. Some formats declare instance access as
+ * required by the UI though, so a host which cannot provide it may refuse to
+ * show the UI at all. Set this to 0 to drop the waveform history instead.
+ */
+#define DISTRHO_PLUGIN_WANT_DIRECT_ACCESS 1
+
 #define DISTRHO_PLUGIN_NUM_INPUTS      2
 #define DISTRHO_PLUGIN_NUM_OUTPUTS     2
 #define DISTRHO_UI_FILE_BROWSER        0
@@ -37,7 +54,13 @@
 enum Parameters {
     kParameterWidth = 0,
     kParameterHeight,
+    kParameterGain,
     kParameterCount
 };
 
+enum States {
+    kStateBlob = 0,     // Chunked blob transfer, see blob_transfer.hpp
+    kStateCount
+};
+
 #endif // DISTRHO_PLUGIN_INFO_H_INCLUDED
@@ -16,19 +16,44 @@
 
 #include "DistrhoPlugin.hpp"
 
+#include "dsp_kernels.hpp"
+#include "blob_transfer.hpp"
+#include "waveform_history.hpp"
+#include "parameter_store.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Level of the editor's test tone, see run()
+static constexpr float kTestToneGain = 0.1f;
+
 // -----------------------------------------------------------------------------------------------------------
 
 /**
   Plugin to show how to get some basic information sent to the UI.
  */
-class GlfwBackendExamplePlugin : public Plugin
+class GlfwBackendExamplePlugin : public Plugin, public WaveformSource
 {
 public:
     GlfwBackendExamplePlugin()
-        : Plugin(kParameterCount, 0, 0),
-          fWidth(float(DISTRHO_UI_DEFAULT_WIDTH)),
-          fHeight(float(DISTRHO_UI_DEFAULT_HEIGHT))
+        : Plugin(kParameterCount, 0, kStateCount),
+          fParameters(kParameterCount),
+          fGain(1.0f),
+          fTargetGain(1.0f),
+          fTestTone(nullptr),
+          fTestTonePosition(0),
+          fWaveformRing(std::make_shared<WaveformRing>())
     {
+        fParameters.set(kParameterWidth, float(DISTRHO_UI_DEFAULT_WIDTH));
+        fParameters.set(kParameterHeight, float(DISTRHO_UI_DEFAULT_HEIGHT));
+        fParameters.set(kParameterGain, 0.0f);
+    }
+
+    // Our UI reaches this through its plugin instance pointer, see waveform_history.hpp
+    std::shared_ptr<WaveformRing> getWaveformRing() const override
+    {
+        return fWaveformRing;
     }
 
 protected:
@@ -136,6 +161,32 @@ protected:
             parameter.symbol = "height";
             parameter.unit   = "px";
             break;
+        case kParameterGain:
+            parameter.hints      = kParameterIsAutomatable;
+            parameter.ranges.def = 0.0f;
+            parameter.ranges.min = -60.0f;
+            parameter.ranges.max = 12.0f;
+            parameter.name   = "Output Gain";
+            parameter.symbol = "gain";
+            parameter.unit   = "dB";
+            break;
+        }
+    }
+
+   /**
+      Initialize the state @a index.
+      This function will be called once, shortly after the plugin is created.
+    */
+    void initState(uint32_t index, State& state) override
+    {
+        switch (index)
+        {
+        case kStateBlob:
+            state.key          = BLOB_TRANSFER_STATE_KEY;
+            state.defaultValue = "";
+            state.label        = "Blob";
+            state.hints        = kStateIsOnlyForDSP;
+            break;
         }
     }
 
@@ -148,16 +199,7 @@ protected:
     */
     float getParameterValue(uint32_t index) const override
     {
-        switch (index)
-        {
-        case kParameterWidth:
-            return fWidth;
-        case kParameterHeight:
-            return fHeight;
-        }
-
-        return 0.0f;
-
+        return fParameters.get(index);
     }
 
    /**
@@ -168,42 +210,143 @@ protected:
     */
     void setParameterValue(uint32_t index, float value) override
     {
-        switch (index)
+        fParameters.set(index, value);
+    }
+
+   /**
+      Get the value of an internal state.
+      The host may call this function from any non-realtime context.
+    */
+    String getState(const char* key) const override
+    {
+        if (std::strcmp(key, BLOB_TRANSFER_STATE_KEY) == 0)
+            return String(fBlobs.encodeLatest().c_str());
+
+        return String();
+    }
+
+   /**
+      Change an internal state.
+      Blob chunks are assembled here, on a non-realtime thread, and handed over to run() when complete.
+    */
+    void setState(const char* key, const char* value) override
+    {
+        if (std::strcmp(key, BLOB_TRANSFER_STATE_KEY) == 0)
         {
-        case kParameterWidth:
-            fWidth = value;
-            break;
-        case kParameterHeight:
-            fHeight = value;
-            break;
+            // Empty value is the default state: nothing to load
+            if (value[0] != '\0' && !fBlobs.receiveChunk(value))
+                d_stderr2("Dropped malformed or out-of-sequence blob chunk");
         }
     }
 
    /* --------------------------------------------------------------------------------------------------------
     * Audio/MIDI Processing */
 
+   /**
+      Activate this plugin.
+      Called before run(), off the audio thread.
+    */
+    void activate() override
+    {
+        // Lets the audio thread trace from its first block without allocating
+        trace_reserve_audio_buffer();
+    }
+
    /**
       Run/process function for plugins without MIDI input.
       @note Some parameters might be null if there are no audio inputs or outputs.
     */
     void run(const float** inputs, float** outputs, uint32_t frames) override
     {
+        TRACE_AUDIO_THREAD("Audio thread");
+        TRACE_SCOPE("run");
+        TRACE_COUNTER("Block frames", frames);
+
+        // Take over a newly received blob, if any. Only swaps pointers.
+        fBlobs.swapAtBlockBoundary();
+
+        // Visit only parameters changed since the last block.
+        // Width and height only size the editor, so gain is the only one applied to audio.
+        const uint32_t changedParameters = fParameters.consumeChanges(kParameterConsumerAudio, [this](uint32_t index, float value) {
+            if (index == kParameterGain)
+                fTargetGain = std::pow(10.0f, value / 20.0f);
+        });
+        TRACE_COUNTER("Changed parameters", changedParameters);
+
        /**
-          This plugin does nothing, it just demonstrates information usage.
-          So here we directly copy inputs over outputs, leaving the audio untouched.
-          We need to be careful in case the host re-uses the same buffer for both inputs and outputs.
+          Apart from an output gain and the editor's test tone, this plugin leaves the audio untouched.
+          We need to be careful in case the host re-uses the same buffer for both inputs and outputs,
+          which the kernels already take care of.
         */
-        if (outputs[0] != inputs[0])
-            std::memcpy(outputs[0], inputs[0], sizeof(float)*frames);
-        if (outputs[1] != inputs[1])
-            std::memcpy(outputs[1], inputs[1], sizeof(float)*frames);
+        const DspKernels& dsp = dsp_kernels();
+        const float gain = fTargetGain;
+
+        for (uint32_t ch = 0; ch < DISTRHO_PLUGIN_NUM_OUTPUTS; ++ch)
+        {
+            // Ramp over one block when the gain changed, so steps don't click
+            if (fGain != gain)
+                dsp.gainRamp(outputs[ch], inputs[ch], fGain, gain, frames);
+            else if (gain != 1.0f)
+                dsp.gain(outputs[ch], inputs[ch], gain, frames);
+            else
+                dsp.copy(outputs[ch], inputs[ch], frames);
+        }
+
+        fGain = gain;
+
+        // The editor sends a mono float wavetable as a blob, which we loop under the signal.
+        // An empty blob stops it.
+        const Blob* const blob = fBlobs.current();
+        const uint32_t toneLength = blob != nullptr ? (uint32_t)(blob->size / sizeof(float)) : 0;
+
+        if (blob != fTestTone || fTestTonePosition >= toneLength)
+        {
+            fTestTone = blob;
+            fTestTonePosition = 0;
+        }
+
+        if (toneLength != 0)
+        {
+            const float* const tone = reinterpret_cast<const float*>(blob->data);
+
+            for (uint32_t done = 0; done < frames;)
+            {
+                const uint32_t count = std::min(frames - done, toneLength - fTestTonePosition);
+                dsp.mixStereo(outputs[0] + done, outputs[1] + done, tone + fTestTonePosition, tone + fTestTonePosition,
+                              kTestToneGain, count);
+
+                done += count;
+                fTestTonePosition = (fTestTonePosition + count) % toneLength;
+            }
+        }
+
+        // Attenuated tails turn into denormals, which would slow down whatever processes our output
+        for (uint32_t ch = 0; ch < DISTRHO_PLUGIN_NUM_OUTPUTS; ++ch)
+            dsp.flushDenormals(outputs[ch], frames);
+
+        // Waveform history for the editor. Returns right away when no editor is reading.
+        fWaveformRing->write(outputs[0], outputs[1], frames);
     }
 
     // -------------------------------------------------------------------------------------------------------
 
 private:
-    // Parameters
-    float fWidth, fHeight;
+    // Parameters. Host may access them from any thread, see parameter_store.hpp.
+    ParameterStore fParameters;
+
+    // Output gain, linear. fGain is what the last block ended at. Audio thread only.
+    float fGain;
+    float fTargetGain;
+
+    // Large payloads from the UI
+    BlobReceiver fBlobs;
+
+    // Test tone blob being looped, and where. Audio thread only.
+    const Blob* fTestTone;
+    uint32_t fTestTonePosition;
+
+    // Output for the editor's waveform history. Shared, as the editor may hold it a little longer.
+    std::shared_ptr<WaveformRing> fWaveformRing;
 
    /**
       Set our plugin class as non-copyable and add a leak detector just in case.
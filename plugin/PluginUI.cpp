@@ -1,18 +1,56 @@
 #include "PluginUI.hpp"
 
+#if DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+#include "DistrhoPlugin.hpp"    // To reach our DSP through getPluginInstancePointer()
+#endif
+
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl2.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 // Forward decls.
 static void glfw_error_callback(int error, const char *description);
 static void glfw_window_close_callback(GLFWwindow *window);
+static void destroy_pooled_window(const PooledEditorWindow &entry);
+static void destroy_expired_pooled_windows();
+static void destroy_all_pooled_windows();
 
 static uint32_t glfw_initialized_cnt = 0;
 
+/**
+ * Library unload: closed editors get a last, bounded chance to finish, then the
+ * window pool is drained. GLFW terminates with the last window, unless a drawing
+ * thread stuck past the deadline still has one.
+ * Both singletons are built first, so they are destroyed after us.
+ */
+static struct UnloadCleanup {
+    UnloadCleanup()
+    {
+        (void)ClosedEditorList::instance();
+        (void)EditorWindowPool::instance();
+    }
+
+    ~UnloadCleanup()
+    {
+        if (const size_t leftBehind = ClosedEditorList::instance().shutdown(ClosedEditorList::kUnloadTimeout))
+            d_stderr2("%zu drawing threads missed the unload deadline, left behind", leftBehind);
+
+        destroy_all_pooled_windows();
+    }
+} unload_cleanup;
+
 GlfwBackendExampleUI::GlfwBackendExampleUI() : UI(DISTRHO_UI_DEFAULT_WIDTH, DISTRHO_UI_DEFAULT_HEIGHT),
-    fWindow(NULL),
-    fMyImGuiContext(nullptr)
+    fSession(std::make_shared<EditorSession>())
 {
+    // DPF creates UIs on the host's main thread
+    TRACE_THREAD_NAME("Main thread");
+
     openEditor();
 }
 
@@ -20,38 +58,169 @@ GlfwBackendExampleUI::~GlfwBackendExampleUI()
 {
     d_stderr2("UI Destructor invoked");
 
-    if (fWindow)
-        glfwSetWindowShouldClose(fWindow, true);
-
     closeEditor();
 }
 
 void GlfwBackendExampleUI::openEditor()
 {
+    TRACE_SCOPE("openEditor");
+
+    // Finished editors first: one may bring a warm window, or stop reading our waveform ring
+    destroy_expired_pooled_windows();
+    ClosedEditorList::instance().sweep(SIZE_MAX, true);
+
+#if DISTRHO_PLUGIN_WANT_DIRECT_ACCESS
+    // Waveform history, if our DSP is reachable and no other editor of it reads its ring already.
+    // Only its WaveformRing is used, see DistrhoPluginInfo.h.
+    if (const auto *source = dynamic_cast<const WaveformSource *>(static_cast<const Plugin *>(getPluginInstancePointer())))
+        fSession->attachWaveform(source->getWaveformRing(), getSampleRate());
+#endif
+
     // Initialize GLFW in main thread
-    if (!setupGLFW())
+    if (!fSession->setupGLFW(this))
         return;
 
+    // Our window's events come from the process-wide pump, driven by all editors' uiIdle()
+    EditorEventPump::instance().subscribe(this);
+
     // Launch drawing thread
-    fDrawingThread = std::thread(imgui_drawing_thread, this);
+    fDrawingThread = std::thread(imgui_drawing_thread, fSession);
 }
 
 void GlfwBackendExampleUI::closeEditor()
 {
-    DISTRHO_SAFE_ASSERT_RETURN(fWindow != NULL, )
+    DISTRHO_SAFE_ASSERT_RETURN(fSession->getWindow() != NULL, )
+
+    TRACE_SCOPE("closeEditor");
+
+    EditorEventPump::instance().unsubscribe(this);
+
+    // Window events keep coming in while we wait, but must not reach us any more
+    fSession->detachOwner();
+
+    // Interrupts frame pacing, and the drawing thread won't start or swap another frame
+    fSession->requestStop();
+
+    /**
+     * Block main thread until drawing thread finishes, but not for long.
+     * A late thread keeps running on its session.
+     */
+    if (!fSession->waitFinished(ClosedEditorList::kCloseTimeout))
+        d_stderr2("Drawing thread missed the close deadline, cleaning up later");
+
+    // The window must leave the host window, which the host is about to destroy along with all children.
+    // Everything else is left to the closed editor sweep. Until then, its events are dropped.
+    glfwSetWindowUserPointer(fSession->getWindow(), nullptr);
+    editor_window_detach(fSession->getWindow());
+    ClosedEditorList::instance().add(std::move(fDrawingThread), fSession);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// EditorSession
+
+EditorSession::EditorSession() :
+    fWindow(NULL),
+    fMyImGuiContext(nullptr),
+    fOwner(nullptr),
+    fWidth(DISTRHO_UI_DEFAULT_WIDTH),
+    fHeight(DISTRHO_UI_DEFAULT_HEIGHT),
+    fShowLatencyOverlay(false),
+    fReusable(false),
+    fTakenFromPool(false),
+    fFontAtlas(nullptr),
+    fOpenStartNs(0),
+    fFirstFramePending(false),
+    fUseSoftwareRenderer(false),
+    fWaveformSeconds(5.0f),
+    fSampleRate(0.0),
+    fHasOutgoingBlob(false),
+    fTestToneFrequency(440),
+    fStopRequested(false),
+    fFinished(false)
+{
+}
+
+EditorSession::~EditorSession()
+{
+    // Both UI and drawing thread are done with us, let the next editor read the waveform
+    if (fWaveformRing)
+        fWaveformRing->detachReader();
+
+    // Still ours if the window was never retired into the pool
+    if (fFontAtlas)
+        IM_DELETE(fFontAtlas);
+}
+
+void EditorSession::attachWaveform(std::shared_ptr<WaveformRing> ring, double sampleRate)
+{
+    fSampleRate.store(sampleRate, std::memory_order_relaxed);
+
+    if (fWaveformRing || !ring || !ring->attachReader())
+        return;
+
+    // History itself is allocated by the drawing thread, see _drawWaveformHistory()
+    fWaveformRing = std::move(ring);
+}
+
+bool EditorSession::takeOutgoingBlob(std::vector<uint8_t> &blob)
+{
+    std::lock_guard<std::mutex> lock(fOutgoingBlobMutex);
+    if (!fHasOutgoingBlob)
+        return false;
+
+    blob.swap(fOutgoingBlob);
+    fOutgoingBlob.clear();
+    fHasOutgoingBlob = false;
+    return true;
+}
 
-    // Block main thread until drawing thread finishes
-    if (fDrawingThread.joinable())
-        fDrawingThread.join();
+void EditorSession::requestStop()
+{
+    fStopRequested.store(true, std::memory_order_release);
+    fFramePacer.interrupt();
+}
+
+bool EditorSession::waitFinished(std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock(fFinishedMutex);
+    return fFinishedCondition.wait_for(lock, timeout, [this] { return fFinished; });
+}
+
+bool EditorSession::isFinished() const
+{
+    std::lock_guard<std::mutex> lock(fFinishedMutex);
+    return fFinished;
+}
+
+void EditorSession::markFinished()
+{
+    {
+        std::lock_guard<std::mutex> lock(fFinishedMutex);
+        fFinished = true;
+    }
+    fFinishedCondition.notify_all();
+}
+
+void EditorSession::retire(bool keepWarm)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(fWindow != NULL, )
 
     // OK, now let's clean up GLFW instance
     if (fMyImGuiContext)
     {
-        fMyImGuiContext = nullptr;
+        if (fReusable)
+        {
+            // Drawing thread has left the GL and ImGui contexts alive for the next editor
+            _releaseWindowToPool(keepWarm);
+        }
+        else
+        {
+            glfwDestroyWindow(fWindow);
+            if (!--glfw_initialized_cnt)
+                glfwTerminate();
+        }
 
-        glfwDestroyWindow(fWindow);
-        if (!--glfw_initialized_cnt)
-            glfwTerminate();
+        fMyImGuiContext = nullptr;
 
         // Manually reset the pointer of GLFW window
         // glfwDestroyWindow() invokes free(), but free() won't reset pointer to NULL.
@@ -60,65 +229,153 @@ void GlfwBackendExampleUI::closeEditor()
     }
 }
 
+bool EditorSession::_takeWindowFromPool(uintptr_t parentWindowHandle)
+{
+    PooledEditorWindow entry;
+    if (!EditorWindowPool::instance().acquire(entry))
+        return false;
+
+    fWindow = entry.window;
+    fMyImGuiContext = entry.imguiContext;
+    fFontAtlas = entry.fontAtlas;
+    fTakenFromPool = true;
+
+    glfwSetWindowSize(fWindow, fWidth, fHeight);
+    editor_window_attach(fWindow, parentWindowHandle);
+
+    return true;
+}
+
+void EditorSession::_releaseWindowToPool(bool keepWarm)
+{
+    PooledEditorWindow entry;
+    entry.window = fWindow;
+    entry.imguiContext = fMyImGuiContext;
+    entry.fontAtlas = fFontAtlas;
+    fFontAtlas = nullptr;
+
+    // Callbacks may fire during detach, and nobody owns the window until the next editor takes it
+    glfwSetWindowUserPointer(fWindow, nullptr);
+    editor_window_detach(fWindow);
+    glfwSetWindowShouldClose(fWindow, false);
+
+    if (!keepWarm || !EditorWindowPool::instance().release(entry))
+        destroy_pooled_window(entry);
+}
+
 
-bool GlfwBackendExampleUI::setupGLFW()
+bool EditorSession::setupGLFW(GlfwBackendExampleUI *owner)
 {
-    /**
-     * Setup window as well as initialized count.
-     * Here I manage a reference count of UI instances and keep glfw initialized
-     * when you have multiple instances open
-     *
-     * This is Justin Frankel's implementation. Noizebox also has this feature
-     * included in his modded GLFW (from which I forked)
-     */
-    if (!glfw_initialized_cnt++)
+    fOwner = owner;
+    fWidth = owner->getWidth();
+    fHeight = owner->getHeight();
+
+    fOpenStartNs = monotonic_now_ns();
+    fFirstFramePending = true;
+
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+    // Software renderer is opt-in at runtime
+    const char *const softwareRendererEnv = std::getenv("GLFW_BACKEND_SOFTWARE_RENDERER");
+    fUseSoftwareRenderer = softwareRendererEnv != nullptr && std::strcmp(softwareRendererEnv, "1") == 0;
+#endif
+
+    // Only embedded GL editors are pooled.
+    // Standalone windows are decorated, and software renderer state lives in this instance.
+    fReusable = !owner->isStandalone() && !fUseSoftwareRenderer;
+
+    if (fReusable && _takeWindowFromPool(owner->getParentWindowHandle()))
     {
-        glfwSetErrorCallback(glfw_error_callback);
-        if (!glfwInit())
-            return GLFW_FALSE;
+        // A pooled window keeps its reference on GLFW, we take it over
     }
-
-    // Omit explicit version specification to let GLFW guess GL version,
-    // or GLFW will fail to load on old environments with GL 2.x
+    else
+    {
+        /**
+         * Setup window as well as initialized count.
+         * Here I manage a reference count of UI instances and keep glfw initialized
+         * when you have multiple instances open
+         *
+         * This is Justin Frankel's implementation. Noizebox also has this feature
+         * included in his modded GLFW (from which I forked)
+         */
+        if (!glfw_initialized_cnt++)
+        {
+            glfwSetErrorCallback(glfw_error_callback);
+            if (!glfwInit())
+                return GLFW_FALSE;
+        }
+
+        // Omit explicit version specification to let GLFW guess GL version,
+        // or GLFW will fail to load on old environments with GL 2.x
 #if 0
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 #endif
 
-    // Enable embedded window
-    if (!isStandalone())
-    {
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Do not allow resizing
-        glfwWindowHint(GLFW_DECORATED, GLFW_FALSE); // Disable decoration. Or you will see a weird titlebar :-)
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+        // Window hints are global, so always set the client API explicitly
+        glfwWindowHint(GLFW_CLIENT_API, fUseSoftwareRenderer ? GLFW_NO_API : GLFW_OPENGL_API);
+#endif
+
+        // Enable embedded window
+        if (!owner->isStandalone())
+        {
+            glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Do not allow resizing
+            glfwWindowHint(GLFW_DECORATED, GLFW_FALSE); // Disable decoration. Or you will see a weird titlebar :-)
 
-        glfwWindowHint(GLFW_EMBEDDED_WINDOW, GLFW_TRUE);
-        glfwWindowHintVoid(GLFW_PARENT_WINDOW_ID, (void*)getParentWindowHandle());
+            glfwWindowHint(GLFW_EMBEDDED_WINDOW, GLFW_TRUE);
+            glfwWindowHintVoid(GLFW_PARENT_WINDOW_ID, (void*)owner->getParentWindowHandle());
+        }
+
+        fWindow = glfwCreateWindow(fWidth, fHeight, DISTRHO_PLUGIN_NAME, NULL, NULL); // This size is only the standalone window's size, NOT editor's size
+        if (fWindow == NULL)
+            return GLFW_FALSE;
     }
 
-    fWindow = glfwCreateWindow(getWidth(), getHeight(), DISTRHO_PLUGIN_NAME, NULL, NULL); // This size is only the standalone window's size, NOT editor's size
-    if (fWindow == NULL)
-        return GLFW_FALSE;
+    // Frame pacer needs the refresh rate. Monitor functions may only be called from main thread.
+    if (GLFWmonitor *monitor = glfwGetPrimaryMonitor())
+    {
+        if (const GLFWvidmode *mode = glfwGetVideoMode(monitor))
+            fFramePacer.setRefreshRate(mode->refreshRate);
+    }
 
     // Explicitly set window position to avoid occasional misplace (offset)
     glfwSetWindowPos(fWindow, 0, 0);
 
     // Set window close callback on standalone mode, otherwise the window cannot exit
-    if (isStandalone())
+    if (owner->isStandalone())
     {
         glfwSetWindowCloseCallback(fWindow, glfw_window_close_callback);
     }
 
-    // Store UI pointer into GLFW
+    // Store session pointer into GLFW
     glfwSetWindowUserPointer(fWindow, this);
 
     return GLFW_TRUE;
 }
 
+void EditorSession::setSize(uint width, uint height)
+{
+    fWidth = width;
+    fHeight = height;
+
+    DISTRHO_SAFE_ASSERT_RETURN(fWindow != NULL && fMyImGuiContext != nullptr, )
+
+    glfwSetWindowSize(fWindow, width, height);
+
+    ImGui::SetCurrentContext(fMyImGuiContext);
+
+    ImGuiIO &io = ImGui::GetIO();
+    (void)io;
+
+    io.DisplaySize.x = (float)width;
+    io.DisplaySize.y = (float)height;
+}
+
 /**
  * Setup ImGui instance.
  * Must be executed under the drawing thread.
  */
-void GlfwBackendExampleUI::setupImGui()
+void EditorSession::setupImGui()
 {
     /**
      * The following two functions MUST be executed under the drawing thread.
@@ -132,13 +389,21 @@ void GlfwBackendExampleUI::setupImGui()
      *
      * What's more, glfwSwapInterval() requires valid current context, otherwise
      * it won't work.
+     *
+     * Without GL (software renderer) there is no context to make current.
      */
-    glfwMakeContextCurrent(fWindow);
-    glfwSwapInterval(1); // Enable vsync
+    if (!fUseSoftwareRenderer)
+    {
+        glfwMakeContextCurrent(fWindow);
+        glfwSwapInterval(1); // Enable vsync
+    }
 
-    // Setup Dear ImGui context
+    // Setup Dear ImGui context.
+    // A reusable window owns its font atlas, which stays with the context in the pool.
     IMGUI_CHECKVERSION();
-    fMyImGuiContext = ImGui::CreateContext();
+    if (fReusable && fFontAtlas == nullptr)
+        fFontAtlas = IM_NEW(ImFontAtlas)();
+    fMyImGuiContext = ImGui::CreateContext(fFontAtlas);
     ImGui::SetCurrentContext(fMyImGuiContext);
 
     ImGuiIO &io = ImGui::GetIO();
@@ -148,8 +413,8 @@ void GlfwBackendExampleUI::setupImGui()
 
     // Set actual editor UI size here
     // TODO: Apply size changes on UI::sizeChanged()
-    io.DisplaySize.x = (float)getWidth();
-    io.DisplaySize.y = (float)getHeight();
+    io.DisplaySize.x = (float)fWidth;
+    io.DisplaySize.y = (float)fHeight;
 
     // Setup Dear ImGui style
     ImGui::StyleColorsDark();
@@ -194,10 +459,24 @@ void GlfwBackendExampleUI::setupImGui()
     // Initialize OpenGL renderer
     ImGui_ImplOpenGL2_Init();
 #else
-    ImGui_ImplGlfw_InitForOpenGL(fWindow, false); // Do not register callbacks automatically
-    ImGui_ImplOpenGL2_Init();
+# if GLFW_BACKEND_SOFTWARE_RENDERER
+    if (fUseSoftwareRenderer)
+    {
+        ImGui_ImplGlfw_InitForOther(fWindow, false); // Do not register callbacks automatically
+        if (!fSoftRenderer.init(fWindow))
+            d_stderr2("Software renderer failed to initialize, editor will stay blank");
+    }
+    else
+# endif
+    {
+        ImGui_ImplGlfw_InitForOpenGL(fWindow, false); // Do not register callbacks automatically
+        ImGui_ImplOpenGL2_Init();
+    }
 #endif
 
+    if (!fUseSoftwareRenderer)
+        _setupFrameCapture();
+
     // Register my own callbacks
     _setMyGLFWCallbacks();
 
@@ -206,37 +485,102 @@ void GlfwBackendExampleUI::setupImGui()
     //io.Fonts->AddFontFromMemoryCompressedTTF(font_compressed_data, font_compressed_size, 16);
 }
 
-void GlfwBackendExampleUI::drawFrame()
+void EditorSession::drawFrame()
 {
 
     // The main drawing process
     // Remember to check myImGuiContext before drawing frames, or ImGui_ImplOpenGL2_NewFrame() may execute
     // on an empty context after closeEditor()!
-    if (fMyImGuiContext)
+    if (fMyImGuiContext && !isStopRequested())
     {
-        ImGui::SetCurrentContext(fMyImGuiContext);    
+        TRACE_SCOPE("drawFrame");
+
+        // In low-latency mode, this delays frame start until just before vblank
+        {
+            TRACE_SCOPE("Wait for frame start");
+            fFramePacer.waitForFrameStart();
+        }
+
+        ImGui::SetCurrentContext(fMyImGuiContext);
+
+        // While interacting, apply all queued input in this frame instead of trickling it over several frames
+        ImGui::GetIO().ConfigInputTrickleEventQueue = !fFramePacer.isFrameActive();
 
         // Process IO events.
         // NOTICE: IO event should be invoked on main thread. See GlfwBackendExampleUI::uiIdle().
         //glfwPollEvents();
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL2_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        {
+            TRACE_SCOPE("New frame");
+
+            if (!fUseSoftwareRenderer)
+                ImGui_ImplOpenGL2_NewFrame();
+
+            // Main thread forwards input events into the same queue meanwhile, see glfw_callbacks.cpp
+            const std::unique_lock<std::mutex> inputLock = fInputLatency.lockInput();
+            ImGui_ImplGlfw_NewFrame();
+
+            // Queued input events are consumed by ImGui::NewFrame(), so this is where they get attributed to a frame
+            fInputLatency.newFrame();
+        }
 
         // Draw main editor window
-        ImGui::ShowDemoWindow();
+        {
+            TRACE_SCOPE("Build UI");
+
+            ImGui::ShowDemoWindow();
+
+            if (fWaveformRing)
+                _drawWaveformHistory();
+
+            _drawTestTone();
+
+            if (fShowLatencyOverlay.load(std::memory_order_relaxed))
+                fInputLatency.drawOverlay();
+        }
 
         // Rendering
-        ImGui::Render();
+        {
+            TRACE_SCOPE("ImGui::Render");
+            ImGui::Render();
+        }
+        TRACE_COUNTER("ImGui vertices", ImGui::GetDrawData()->TotalVtxCount);
+
         int display_w, display_h;
         glfwGetFramebufferSize(fWindow, &display_w, &display_h);
+
+        static constexpr ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+
+        // Closing editor: don't risk blocking in a swap nobody will see
+        if (isStopRequested())
+            return;
+
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+        if (fUseSoftwareRenderer)
+        {
+            // Rasterise on CPU and present through X11. No GL calls allowed on this path.
+            // present() syncs with the X server, so there is never more than one frame queued.
+            {
+                TRACE_SCOPE("Software render");
+                fSoftRenderer.render(ImGui::GetDrawData(), display_w, display_h, clear_color);
+            }
+            fFramePacer.beforeSwap();
+            {
+                TRACE_SCOPE("Present");
+                fSoftRenderer.present();
+            }
+            fFramePacer.afterSwap();
+
+            fInputLatency.frameSwapped();
+            return;
+        }
+#endif
+
         glViewport(0, 0, display_w, display_h);
 
         //ImGuiIO &io = ImGui::GetIO();
         //glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        static constexpr ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
         glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
 
@@ -245,14 +589,253 @@ void GlfwBackendExampleUI::drawFrame()
         //GLint last_program;
         //glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
         //glUseProgram(0);
-        ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+        {
+            TRACE_SCOPE("Render draw data");
+            ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+        }
         //glUseProgram(last_program);
 
+#if GLFW_BACKEND_FRAME_CAPTURE
+        // Queue a readback of the back buffer, publish earlier ones which are done. Never waits for the GPU.
+        if (fFrameCapture.isEnabled())
+        {
+            TRACE_SCOPE("Frame capture");
+            fFrameCapture.capture(display_w, display_h);
+        }
+#endif
+
         // Let GLFW render our UI
         // Omitting those two function calls will end up with a blank window.
         glfwMakeContextCurrent(fWindow);
-        glfwSwapBuffers(fWindow);
+        fFramePacer.beforeSwap();
+        {
+            TRACE_SCOPE("Swap buffers");
+            glfwSwapBuffers(fWindow);
+
+            // Keep at most one frame queued while interacting
+            if (fFramePacer.isFrameActive())
+                glFinish();
+        }
+        fFramePacer.afterSwap();
+
+        fInputLatency.frameSwapped();
+
+        if (fFirstFramePending)
+        {
+            fFirstFramePending = false;
+            TRACE_SPAN(fTakenFromPool ? "Open editor (warm)" : "Open editor (cold)", fOpenStartNs, monotonic_now_ns());
+        }
+    }
+}
+
+/**
+ * Waveform of the DSP output, as far back as the history goes.
+ * One vertex pair per pixel column at any zoom, see waveform_history.hpp.
+ */
+void EditorSession::_drawWaveformHistory()
+{
+    TRACE_SCOPE("Waveform history");
+
+    // Not on the host's main thread when opening, see waveform_history.hpp for its size
+    if (!fWaveformHistory)
+    {
+        TRACE_SCOPE("Allocate waveform history");
+        fWaveformHistory.reset(new WaveformHistory());
+    }
+
+    // O(new samples)
+    fWaveformHistory->update(*fWaveformRing);
+
+    const double sampleRate = fSampleRate.load(std::memory_order_relaxed);
+    if (sampleRate <= 0.0)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(480, 160), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Waveform history"))
+    {
+        const float maxSeconds = (float)((double)fWaveformHistory->getCapacity() / sampleRate);
+        ImGui::SliderFloat("Length", &fWaveformSeconds, 0.01f, maxSeconds, "%.2f s", ImGuiSliderFlags_Logarithmic);
+
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        const ImVec2 size = ImGui::GetContentRegionAvail();
+        // Wider than the history is sized for, the rest stays empty
+        const uint32_t columns = size.x >= 1.0f ? std::min((uint32_t)size.x, fWaveformHistory->getMaxColumns()) : 0;
+
+        if (columns >= 2 && size.y >= 1.0f)
+        {
+            fWaveformMins.resize(columns);
+            fWaveformMaxs.resize(columns);
+
+            const uint64_t span = (uint64_t)((double)fWaveformSeconds * sampleRate);
+            const uint32_t first = fWaveformHistory->query(span, columns, fWaveformMins.data(), fWaveformMaxs.data());
+
+            ImDrawList *drawList = ImGui::GetWindowDrawList();
+            drawList->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(20, 24, 28, 255));
+
+            const uint32_t count = columns - first;
+            if (count >= 2)
+            {
+                const float middle = origin.y + size.y * 0.5f;
+                const float halfHeight = size.y * 0.5f;
+                const ImVec2 uv = ImGui::GetFontTexUvWhitePixel();
+                const ImU32 color = IM_COL32(110, 200, 255, 255);
+
+                // A ribbon: top and bottom vertex per column, two triangles to the next column
+                drawList->PrimReserve((int)(count - 1) * 6, (int)count * 2);
+                const ImDrawIdx base = (ImDrawIdx)drawList->_VtxCurrentIdx;
+
+                for (uint32_t column = first; column < columns; ++column)
+                {
+                    const float x = origin.x + (float)column + 0.5f;
+                    float top = middle - std::min(fWaveformMaxs[column], 1.0f) * halfHeight;
+                    float bottom = middle - std::max(fWaveformMins[column], -1.0f) * halfHeight;
+
+                    // Never thinner than a pixel, or silence would vanish
+                    if (bottom - top < 1.0f)
+                    {
+                        const float center = (top + bottom) * 0.5f;
+                        top = center - 0.5f;
+                        bottom = center + 0.5f;
+                    }
+
+                    drawList->PrimWriteVtx(ImVec2(x, top), uv, color);
+                    drawList->PrimWriteVtx(ImVec2(x, bottom), uv, color);
+                }
+
+                for (uint32_t i = 0; i + 1 < count; ++i)
+                {
+                    const ImDrawIdx v = (ImDrawIdx)(base + i * 2);
+                    drawList->PrimWriteIdx(v);
+                    drawList->PrimWriteIdx((ImDrawIdx)(v + 1));
+                    drawList->PrimWriteIdx((ImDrawIdx)(v + 3));
+                    drawList->PrimWriteIdx(v);
+                    drawList->PrimWriteIdx((ImDrawIdx)(v + 3));
+                    drawList->PrimWriteIdx((ImDrawIdx)(v + 2));
+                }
+            }
+        }
+
+        ImGui::Dummy(size);
+    }
+    ImGui::End();
+}
+
+/**
+ * Sends the DSP a wavetable through the blob transfer, which it loops under
+ * its output. One second long, so whole-Hz tones loop without a click.
+ */
+void EditorSession::_drawTestTone()
+{
+    ImGui::SetNextWindowSize(ImVec2(320, 0), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Test tone"))
+    {
+        ImGui::SliderInt("Frequency", &fTestToneFrequency, 20, 2000, "%d Hz", ImGuiSliderFlags_Logarithmic);
+
+        const bool play = ImGui::Button("Play");
+        ImGui::SameLine();
+        const bool stop = ImGui::Button("Stop");
+
+        if (play || stop)
+        {
+            std::vector<uint8_t> blob;
+
+            if (play)
+            {
+                const double sampleRate = fSampleRate.load(std::memory_order_relaxed);
+                const uint32_t length = sampleRate > 0.0 ? (uint32_t)sampleRate : 48000;
+                std::vector<float> table(length);
+
+                for (uint32_t i = 0; i < length; ++i)
+                    table[i] = (float)std::sin(2.0 * 3.14159265358979323846 * fTestToneFrequency * i / length);
+
+                blob.resize(table.size() * sizeof(float));
+                std::memcpy(blob.data(), table.data(), blob.size());
+            }
+
+            // Sent by the main thread from uiIdle(), see GlfwBackendExampleUI::uiIdle()
+            std::lock_guard<std::mutex> lock(fOutgoingBlobMutex);
+            fOutgoingBlob = std::move(blob);
+            fHasOutgoingBlob = true;
+        }
+    }
+    ImGui::End();
+}
+
+/**
+ * Frame capture is built in with -DGLFW_BACKEND_FRAME_CAPTURE=ON, and only runs
+ * with GLFW_BACKEND_CAPTURE=<shared memory name>.
+ */
+void EditorSession::_setupFrameCapture()
+{
+#if GLFW_BACKEND_FRAME_CAPTURE
+    const char *const captureEnv = std::getenv("GLFW_BACKEND_CAPTURE");
+    if (captureEnv != nullptr && captureEnv[0] != '\0')
+        fFrameCapture.init(captureEnv);
+#endif
+}
+
+/**
+ * Release renderer resources of the current ImGui context.
+ * Must be executed under the drawing thread.
+ */
+void EditorSession::shutdownRenderer()
+{
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+    if (fUseSoftwareRenderer)
+    {
+        fSoftRenderer.shutdown();
+        return;
+    }
+#endif
+
+#if GLFW_BACKEND_FRAME_CAPTURE
+    fFrameCapture.shutdown();
+#endif
+    ImGui_ImplOpenGL2_Shutdown();
+}
+
+/**
+ * Take over an ImGui context which came from the window pool.
+ * Backends and font texture are ready, the rest starts as in setupImGui().
+ * Must be executed under the drawing thread.
+ */
+void EditorSession::resumeImGui()
+{
+    // See setupImGui() on why these must run here
+    glfwMakeContextCurrent(fWindow);
+    glfwSwapInterval(1); // Enable vsync
+
+    ImGui::SetCurrentContext(fMyImGuiContext);
+
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize.x = (float)fWidth;
+    io.DisplaySize.y = (float)fHeight;
+
+    ImGui::StyleColorsDark();
+
+    // Pooled windows are GL only. Our GLFW callbacks are still registered on the window.
+    _setupFrameCapture();
+}
+
+/**
+ * Leave the ImGui context for the window pool, with nothing of this editor left in it.
+ * Must be executed under the drawing thread.
+ */
+void EditorSession::suspendImGui()
+{
+    // Buffers belong to this session, the GL context stays in the pool
+#if GLFW_BACKEND_FRAME_CAPTURE
+    fFrameCapture.shutdown();
+#endif
+
+    // Main thread may still forward input until closeEditor() takes the window away
+    {
+        const std::unique_lock<std::mutex> inputLock = fInputLatency.lockInput();
+        editor_imgui_reset(fMyImGuiContext);
     }
+
+    // Next owner makes the GL context current on its own drawing thread
+    glfwMakeContextCurrent(NULL);
 }
 
 /**
@@ -261,6 +844,8 @@ void GlfwBackendExampleUI::drawFrame()
 */
 void GlfwBackendExampleUI::parameterChanged(uint32_t index, float value)
 {
+    TRACE_SCOPE("parameterChanged");
+
     d_stdout("parameterChanged %u %f", index, value);
 
     switch (index)
@@ -274,12 +859,23 @@ void GlfwBackendExampleUI::parameterChanged(uint32_t index, float value)
     }
 }
 
+void GlfwBackendExampleUI::sampleRateChanged(double newSampleRate)
+{
+    fSession->setSampleRate(newSampleRate);
+}
+
 
 void GlfwBackendExampleUI::uiIdle()
 {
-    DISTRHO_SAFE_ASSERT_RETURN(fWindow != NULL && fMyImGuiContext != nullptr, )
+    DISTRHO_SAFE_ASSERT_RETURN(fSession->getWindow() != NULL && fSession->getImGuiContext() != nullptr, )
+
+    TRACE_SCOPE("uiIdle");
 
-    if (!glfwWindowShouldClose(fWindow))
+    // Retire at most one closed editor per tick, so closing many at once never stalls one tick
+    destroy_expired_pooled_windows();
+    ClosedEditorList::instance().sweep(1, true);
+
+    if (!glfwWindowShouldClose(fSession->getWindow()))
     {
         // Poll and handle events (inputs, window resize, etc.)
         // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
@@ -290,9 +886,19 @@ void GlfwBackendExampleUI::uiIdle()
         // NOTICE: After applying our own callback, we should invoke glfwPollEvents() in MAIN thread,
         //         not drawing thread.
         //         (According to GLFW's document.)
+        //         It polls for every window of the process, so the pump does it once per tick
+        //         for all editors, whichever of them idles first.
         // FIXME: This is not fluent enough (event sample rate is obviously lower!)
-        glfwPollEvents();
+        EditorEventPump::instance().pump(this);
     }
+
+    // Test tone from the editor, encoded off this thread by the sender
+    std::vector<uint8_t> blob;
+    if (fSession->takeOutgoingBlob(blob))
+        sendBlob(std::move(blob));
+
+    // A few blob chunks per tick, so the host never gets one huge state message
+    fBlobSender.pump([this](const char *key, const char *value) { setState(key, value); }, 4);
 }
 
 
@@ -303,17 +909,7 @@ void GlfwBackendExampleUI::focus()
 
 void GlfwBackendExampleUI::sizeChanged(uint width, uint height)
 {
-    DISTRHO_SAFE_ASSERT_RETURN(fWindow != NULL && fMyImGuiContext != nullptr, )
-
-    glfwSetWindowSize(fWindow, width, height);
-
-    ImGui::SetCurrentContext(fMyImGuiContext);
-
-    ImGuiIO &io = ImGui::GetIO();
-    (void)io;
-
-    io.DisplaySize.x = (float)getWidth();
-    io.DisplaySize.y = (float)getHeight();
+    fSession->setSize(width, height);
 }
 
 void GlfwBackendExampleUI::titleChanged(const char* title)
@@ -336,30 +932,82 @@ void GlfwBackendExampleUI::transientParentWindowChanged(const uintptr_t winId)
  * The drawing thread function.
  * It should be a global function rather than a class member.
  *
- * @param editor The active editor instance.
+ * @param session The active editor session. Shared, so the thread can outlive a UI which stopped waiting for it.
 
  * FIXME: Try non-static function, and set friend in the UI class?
  */
-static void imgui_drawing_thread(GlfwBackendExampleUI *editor)
+static void imgui_drawing_thread(std::shared_ptr<EditorSession> session)
 {
-    // Setup ImGui
-    editor->setupImGui();
+    TRACE_THREAD_NAME("Drawing thread");
+
+    // Setup ImGui, or take over the one which came with a pooled window
+    if (session->isTakenFromPool())
+        session->resumeImGui();
+    else
+        session->setupImGui();
 
     // Render UI
-    while (!glfwWindowShouldClose(editor->getWindow())) {
-        editor->drawFrame();
+    while (!glfwWindowShouldClose(session->getWindow()) && !session->isStopRequested()) {
+        session->drawFrame();
     }
 
     // Set current context to make sure that the following two shutdown functions
     // can be in right context
-    ImGui::SetCurrentContext(editor->getImGuiContext());
+    ImGui::SetCurrentContext(session->getImGuiContext());
 
     // Cleanup
+    if (session->isReusable())
+    {
+        // Keep everything for the window pool, see EditorSession::retire()
+        session->suspendImGui();
+    }
+    else
+    {
+        session->shutdownRenderer();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext(session->getImGuiContext());
+    }
+
+    d_stderr2("Drawing thread finished!");
+
+    session->markFinished();
+}
+
+/**
+ * Fully destroy a window which was meant for the window pool.
+ * Main thread only. The GL context must not be current on any other thread.
+ */
+static void destroy_pooled_window(const PooledEditorWindow &entry)
+{
+    TRACE_SCOPE("Destroy pooled window");
+
+    // Renderer objects live in the window's GL context
+    glfwMakeContextCurrent(entry.window);
+    ImGui::SetCurrentContext(entry.imguiContext);
+
     ImGui_ImplOpenGL2_Shutdown();
     ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext(editor->getImGuiContext());
+    ImGui::DestroyContext(entry.imguiContext);
 
-    d_stderr2("Drawing thread finished!");
+    glfwMakeContextCurrent(NULL);
+
+    IM_DELETE(entry.fontAtlas);
+    glfwDestroyWindow(entry.window);
+
+    if (!--glfw_initialized_cnt)
+        glfwTerminate();
+}
+
+static void destroy_expired_pooled_windows()
+{
+    for (const PooledEditorWindow &entry : EditorWindowPool::instance().takeExpired())
+        destroy_pooled_window(entry);
+}
+
+static void destroy_all_pooled_windows()
+{
+    for (const PooledEditorWindow &entry : EditorWindowPool::instance().takeAll())
+        destroy_pooled_window(entry);
 }
 
 
@@ -377,7 +1025,11 @@ static void glfw_window_close_callback(GLFWwindow *window)
 
     // Explicitly request DISTRHO UI to close, by invoking DISTRHO::UI::hide().
     // Reference: deps/dpf/examples/EmbedExternalUI/EmbedExternalExampleUI.cpp
-    static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(window))->hide();
+    if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(window)))
+    {
+        if (GlfwBackendExampleUI *owner = session->getOwner())
+            owner->hide();
+    }
 }
 
 /* ------------------------------------------------------------------------------------------------------------
@@ -29,58 +29,167 @@
 #include <GLFW/glfw3native.h>
 #include <imgui.h>
 
+#include "input_latency.hpp"
+#include "frame_pacer.hpp"
+#include "blob_transfer.hpp"
+#include "window_pool.hpp"
+#include "closed_editors.hpp"
+#include "event_pump.hpp"
+#if GLFW_BACKEND_FRAME_CAPTURE
+#include "frame_capture.hpp"
+#endif
+#include "trace.hpp"
+#include "monotonic_clock.hpp"
+#include "waveform_history.hpp"
+
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+#include "soft_renderer.hpp"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 
+class GlfwBackendExampleUI;
+
 // -----------------------------------------------------------------------------------------------------------
-// SynthV1PluginUI - DPF Plugin UI interface.
+// EditorSession - GLFW window, ImGui context and everything else the drawing thread touches.
+
+/**
+ * A session is shared by the UI and its drawing thread.
+ *
+ * Closing an editor asks the drawing thread to stop, then waits for it, but only
+ * for a bounded time: a frame may be stuck in a vsync swap on a hidden window, or
+ * in a slow driver. If the thread misses the deadline, the UI goes away without
+ * it. The thread finishes and cleans up on the session alone. Either way the main
+ * thread destroys or pools the window later, from another editor's uiIdle() or
+ * openEditor(). See GlfwBackendExampleUI::closeEditor() and closed_editors.hpp.
+ *
+ * So the drawing thread must never reach the UI from here. Only main thread code
+ * may use fOwner, which is cleared when the UI closes.
+ */
+class EditorSession : public ClosingEditor {
 
+    // ----------------------------------------------------------------------------------------------------------------
+    GLFWwindow *fWindow;
+    ImGuiContext *fMyImGuiContext;
 
-class GlfwBackendExampleUI : public UI {
+    GlfwBackendExampleUI *fOwner;
 
-    // ----------------------------------------------------------------------------------------------------------------
-    std::thread fDrawingThread;
+    // Editor size, as the drawing thread must not ask the UI
+    std::atomic<uint> fWidth;
+    std::atomic<uint> fHeight;
 
-    GLFWwindow *fWindow;
-    ImGuiContext *fMyImGuiContext = nullptr;
+    // Input-to-swap latency, split by event type
+    InputLatencyTracker fInputLatency;
+    std::atomic<bool> fShowLatencyOverlay;
+
+    // Low-latency interaction mode
+    FramePacer fFramePacer;
+
+    // Window pool. See window_pool.hpp.
+    bool fReusable;             // Park window in the pool on close instead of destroying it
+    bool fTakenFromPool;        // Window and ImGui context came from the pool
+    ImFontAtlas *fFontAtlas;    // Own atlas of a reusable window, shared into its ImGui context
+    uint64_t fOpenStartNs;      // For open-to-first-frame latency
+    bool fFirstFramePending;
+
+    // Render with SoftRenderer instead of OpenGL. Decided in setupGLFW().
+    bool fUseSoftwareRenderer;
+#if GLFW_BACKEND_SOFTWARE_RENDERER
+    SoftRenderer fSoftRenderer;
+#endif
+
+#if GLFW_BACKEND_FRAME_CAPTURE
+    // Asynchronous readback of frames into shared memory. GL path only, see frame_capture.hpp.
+    FrameCapture fFrameCapture;
+#endif
+
+    // Waveform history of the DSP output. Only when we can reach the DSP (direct access).
+    std::shared_ptr<WaveformRing> fWaveformRing;
+    std::unique_ptr<WaveformHistory> fWaveformHistory;
+    std::vector<float> fWaveformMins;
+    std::vector<float> fWaveformMaxs;
+    float fWaveformSeconds;
+    std::atomic<double> fSampleRate;
+
+    // Test tone wavetable built by the drawing thread, for the main thread to send as a blob
+    std::mutex fOutgoingBlobMutex;
+    std::vector<uint8_t> fOutgoingBlob;
+    bool fHasOutgoingBlob;
+    int fTestToneFrequency;
+
+    // Stop signal for the drawing thread, and its answer
+    std::atomic<bool> fStopRequested;
+    mutable std::mutex fFinishedMutex;
+    std::condition_variable fFinishedCondition;
+    bool fFinished;
 
 public:
-    GlfwBackendExampleUI();
-    ~GlfwBackendExampleUI();
+    EditorSession();
+    ~EditorSession() override;
 
     GLFWwindow *getWindow() { return this->fWindow; }
     ImGuiContext *getImGuiContext() { return this->fMyImGuiContext; }
 
-    void openEditor();
-    void closeEditor();
-
-protected:
     // ----------------------------------------------------------------------------------------------------------------
-    // DSP/Plugin Callbacks
+    // Main thread methods.
 
-    void parameterChanged(uint32_t index, float value) override;
-    //void programLoaded(uint32_t index) override;
-    //void stateChanged(const char* key, const char* value) override;
+    bool setupGLFW(GlfwBackendExampleUI *owner);
+    void setSize(uint width, uint height);
+
+    // Become the reader of the DSP's waveform ring. Call before the drawing thread starts.
+    void attachWaveform(std::shared_ptr<WaveformRing> ring, double sampleRate);
+    void setSampleRate(double sampleRate) { fSampleRate.store(sampleRate, std::memory_order_relaxed); }
+
+    // Blob the editor wants sent to the DSP, if any. Cheap, swaps a vector.
+    bool takeOutgoingBlob(std::vector<uint8_t> &blob);
+
+    // The UI is going away. Window events no longer reach it.
+    void detachOwner() { fOwner = nullptr; }
+    GlfwBackendExampleUI *getOwner() const { return fOwner; }
+
+    // Park or destroy the window once the drawing thread has finished.
+    // keepWarm allows parking it in the window pool.
+    void retire(bool keepWarm) override;
 
     // ----------------------------------------------------------------------------------------------------------------
-    // External window overrides
+    // Thread-safe methods.
 
-    void focus() override;
-    void sizeChanged(uint width, uint height) override;
-    void titleChanged(const char* const title) override;
-    void transientParentWindowChanged(const uintptr_t winId) override;
-    void visibilityChanged(const bool visible) override;
-    void uiIdle() override;
+    // Ask the drawing thread to stop. It won't start or swap another frame.
+    void requestStop();
+    bool isStopRequested() const { return fStopRequested.load(std::memory_order_acquire); }
 
-public:
+    // Wait at most timeout for the drawing thread to finish. Returns true if it has.
+    bool waitFinished(std::chrono::milliseconds timeout) const override;
+    bool isFinished() const override;
+
+    InputLatencyStats getInputLatencyStats(InputEventType type) const { return fInputLatency.getStats(type); }
+    void resetInputLatencyStats() { fInputLatency.reset(); }
+    void setInputLatencyOverlayVisible(bool visible) { fShowLatencyOverlay.store(visible); }
+    void setLowLatencyMode(bool enabled) { fFramePacer.setEnabled(enabled); }
 
     // ----------------------------------------------------------------------------------------------------------------
     // Renderer methods. Invoked by drawing thread.
-    // NOTE: C++ does not support assigning a static function as friend function. So I have to use public function.
-    
-    bool setupGLFW();
+
     void setupImGui();
     void drawFrame();
+    void shutdownRenderer();
+
+    // Take over the ImGui context of a pooled window, or leave ours for the pool
+    void resumeImGui();
+    void suspendImGui();
+
+    // Last thing the drawing thread does
+    void markFinished();
+
+    bool isReusable() const { return fReusable; }
+    bool isTakenFromPool() const { return fTakenFromPool; }
 
 private:
 
@@ -95,17 +204,94 @@ private:
     void _scrollCallback(double xoffset, double yoffset);
     void _keyCallback(int key, int scancode, int action, int mods);
     void _cursorPosCallback(double x, double y);
+    void _windowFocusCallback(int focused);
+
+    // Tell the frame pacer which mouse buttons GLFW sees held
+    void _syncHeldButtons();
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Widgets. Drawing thread only.
+
+    void _drawWaveformHistory();
+    void _drawTestTone();
+
+    void _setupFrameCapture();
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Window pool helpers. Main thread only.
+
+    bool _takeWindowFromPool(uintptr_t parentWindowHandle);
+    void _releaseWindowToPool(bool keepWarm);
 
 #if _WIN32
     WNDPROC fPrevWndProc;
 #endif
 
+    DISTRHO_DECLARE_NON_COPYABLE(EditorSession)
+};
+
+// -----------------------------------------------------------------------------------------------------------
+// SynthV1PluginUI - DPF Plugin UI interface.
+
+
+class GlfwBackendExampleUI : public UI {
+
+    // ----------------------------------------------------------------------------------------------------------------
+    std::thread fDrawingThread;
+
+    // Window and drawing state, shared with the drawing thread
+    std::shared_ptr<EditorSession> fSession;
+
+    // Large payloads to the DSP, sent in chunks from uiIdle()
+    BlobSender fBlobSender;
+
+public:
+    GlfwBackendExampleUI();
+    ~GlfwBackendExampleUI();
+
+    GLFWwindow *getWindow() { return fSession->getWindow(); }
+    ImGuiContext *getImGuiContext() { return fSession->getImGuiContext(); }
+
+    void openEditor();
+    void closeEditor();
+
+    // Input-to-swap latency of this instance. Safe to call from any thread.
+    InputLatencyStats getInputLatencyStats(InputEventType type) const { return fSession->getInputLatencyStats(type); }
+    void resetInputLatencyStats() { fSession->resetInputLatencyStats(); }
+    void setInputLatencyOverlayVisible(bool visible) { fSession->setInputLatencyOverlayVisible(visible); }
+
+    // Opt-in low-latency drawing while a mouse button is held. See frame_pacer.hpp.
+    void setLowLatencyMode(bool enabled) { fSession->setLowLatencyMode(enabled); }
+
+    // Send a large payload to the DSP without blocking. May be called from any thread.
+    void sendBlob(std::vector<uint8_t> blob) { fBlobSender.send(std::move(blob)); }
+
+protected:
+    // ----------------------------------------------------------------------------------------------------------------
+    // DSP/Plugin Callbacks
+
+    void parameterChanged(uint32_t index, float value) override;
+    void sampleRateChanged(double newSampleRate) override;
+    //void programLoaded(uint32_t index) override;
+    //void stateChanged(const char* key, const char* value) override;
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // External window overrides
+
+    void focus() override;
+    void sizeChanged(uint width, uint height) override;
+    void titleChanged(const char* const title) override;
+    void transientParentWindowChanged(const uintptr_t winId) override;
+    void visibilityChanged(const bool visible) override;
+    void uiIdle() override;
+
+private:
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GlfwBackendExampleUI)
 };
 
 // -----------------------------------------------------------------------------------------------------------
 
-static void imgui_drawing_thread(GlfwBackendExampleUI *editorInstance);
+static void imgui_drawing_thread(std::shared_ptr<EditorSession> session);
 
 #endif// __synthv1_dpfui_h
 
@@ -0,0 +1,423 @@
+/*
+ *  blob_transfer.cpp - Non-blocking transfer of large blobs from UI to DSP
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "blob_transfer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Raw bytes per chunk. Base64 makes it about 1/3 bigger on the wire.
+static constexpr size_t kChunkBytes = 64 * 1024;
+
+// Refuse anything bigger, a broken or hostile state should not make us allocate gigabytes
+static constexpr size_t kMaxBlobBytes = 256 * 1024 * 1024;
+
+// How often the reclaimer looks for a swap while one is outstanding. A few audio blocks.
+static constexpr std::chrono::milliseconds kReclaimPollInterval(20);
+
+// ------------------------------------------------------------------------------------------------------------
+// Base64
+
+static const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void base64_encode(std::string &out, const uint8_t *data, size_t size)
+{
+    out.reserve(out.size() + (size + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3)
+    {
+        const uint32_t v = (uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2];
+        out += kBase64Alphabet[(v >> 18) & 63];
+        out += kBase64Alphabet[(v >> 12) & 63];
+        out += kBase64Alphabet[(v >> 6) & 63];
+        out += kBase64Alphabet[v & 63];
+    }
+
+    if (i < size)
+    {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < size)
+            v |= (uint32_t)data[i + 1] << 8;
+
+        out += kBase64Alphabet[(v >> 18) & 63];
+        out += kBase64Alphabet[(v >> 12) & 63];
+        out += i + 1 < size ? kBase64Alphabet[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+}
+
+static int base64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Appends to out. Returns false on invalid input.
+static bool base64_decode(std::vector<uint8_t> &out, const char *text)
+{
+    uint32_t accumulator = 0;
+    int bits = 0;
+
+    for (const char *p = text; *p != '\0' && *p != '='; ++p)
+    {
+        const int v = base64_value(*p);
+        if (v < 0)
+            return false;
+
+        accumulator = accumulator << 6 | (uint32_t)v;
+        bits += 6;
+
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back((uint8_t)(accumulator >> bits));
+        }
+    }
+
+    return true;
+}
+
+// Parses "<id>:<index>:<count>:<total>:" and returns a pointer to the payload, or nullptr
+static const char *parse_chunk_header(const char *value, uint32_t &id, uint32_t &index, uint32_t &count, size_t &total)
+{
+    unsigned long fields[4];
+    const char *p = value;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        char *end = nullptr;
+        fields[i] = std::strtoul(p, &end, 10);
+        if (end == p || *end != ':')
+            return nullptr;
+        p = end + 1;
+    }
+
+    id = (uint32_t)fields[0];
+    index = (uint32_t)fields[1];
+    count = (uint32_t)fields[2];
+    total = (size_t)fields[3];
+
+    return p;
+}
+
+static std::string format_chunk_header(uint32_t id, uint32_t index, uint32_t count, size_t total)
+{
+    char header[64];
+    std::snprintf(header, sizeof(header), "%u:%u:%u:%llu:", id, index, count, (unsigned long long)total);
+    return header;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// BlobReceiver
+
+BlobReceiver::BlobReceiver() :
+    fStagingId(0),
+    fStagingNext(0),
+    fStagingCount(0),
+    fStagingTotal(0),
+    fLatestId(0),
+    fPending(nullptr),
+    fRetired(nullptr),
+    fSwapCount(0),
+    fReclaimQuit(false),
+    fExpectedSwaps(0),
+    fCurrent(nullptr)
+{
+}
+
+BlobReceiver::~BlobReceiver()
+{
+    {
+        std::lock_guard<std::mutex> lock(fReclaimMutex);
+        fReclaimQuit = true;
+    }
+    fReclaimCondition.notify_one();
+
+    if (fReclaimer.joinable())
+        fReclaimer.join();
+
+    // Audio processing has stopped by now
+    delete fPending.exchange(nullptr);
+    delete fRetired.exchange(nullptr);
+    delete fCurrent;
+}
+
+bool BlobReceiver::receiveChunk(const char *value)
+{
+    uint32_t id, index, count;
+    size_t total;
+
+    const char *payload = parse_chunk_header(value, id, index, count, total);
+    if (payload == nullptr || count == 0 || index >= count || total > kMaxBlobBytes)
+        return false;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    // Good moment to free what the audio thread gave back
+    reclaim();
+
+    if (index == 0)
+    {
+        // A new blob, abandon whatever was half received
+        fStagingId = id;
+        fStagingCount = count;
+        fStagingTotal = total;
+        fStaging.clear();
+        fStaging.reserve(total);
+    }
+    else if (id != fStagingId || index != fStagingNext || count != fStagingCount)
+    {
+        // Out of sequence, e.g. a chunk of a superseded blob
+        return false;
+    }
+
+    if (!base64_decode(fStaging, payload) || fStaging.size() > fStagingTotal)
+    {
+        fStagingCount = 0;
+        return false;
+    }
+
+    fStagingNext = index + 1;
+
+    if (fStagingNext == fStagingCount)
+    {
+        fStagingCount = 0;
+
+        if (fStaging.size() != fStagingTotal)
+            return false;
+
+        _publish(std::make_shared<const std::vector<uint8_t>>(std::move(fStaging)), id);
+        fStaging = std::vector<uint8_t>();
+    }
+
+    return true;
+}
+
+void BlobReceiver::_publish(std::shared_ptr<const std::vector<uint8_t>> bytes, uint32_t id)
+{
+    Blob *blob = new Blob;
+    blob->id = id;
+    blob->data = bytes->data();
+    blob->size = bytes->size();
+    blob->bytes = bytes;
+
+    fLatest = std::move(bytes);
+    fLatestId = id;
+
+    // If the audio thread has not picked up the previous one yet, it never will: drop it here.
+    Blob *const dropped = fPending.exchange(blob, std::memory_order_acq_rel);
+    delete dropped;
+
+    // Have the reclaimer free whatever this one replaces, once the audio thread has swapped it in
+    {
+        std::lock_guard<std::mutex> lock(fReclaimMutex);
+
+        if (dropped == nullptr)
+            ++fExpectedSwaps;
+
+        if (!fReclaimer.joinable())
+            fReclaimer = std::thread(&BlobReceiver::_reclaimLoop, this);
+    }
+    fReclaimCondition.notify_one();
+}
+
+// Under fReclaimMutex
+bool BlobReceiver::_isSwapOutstanding() const
+{
+    // Acquire pairs with the count in swapAtBlockBoundary(), so a retired blob is visible once counted
+    return fSwapCount.load(std::memory_order_acquire) != fExpectedSwaps ||
+           fRetired.load(std::memory_order_acquire) != nullptr;
+}
+
+void BlobReceiver::_reclaimLoop()
+{
+    std::unique_lock<std::mutex> lock(fReclaimMutex);
+
+    for (;;)
+    {
+        fReclaimCondition.wait(lock, [this] { return fReclaimQuit || _isSwapOutstanding(); });
+        if (fReclaimQuit)
+            return;
+
+        // The audio thread takes the blob at its next block. No way to be told without
+        // making it signal us, so look again shortly.
+        if (fReclaimCondition.wait_for(lock, kReclaimPollInterval, [this] { return fReclaimQuit; }))
+            return;
+
+        reclaim();
+    }
+}
+
+std::string BlobReceiver::encodeLatest() const
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    if (!fLatest)
+        return std::string();
+
+    std::string out = format_chunk_header(fLatestId, 0, 1, fLatest->size());
+    base64_encode(out, fLatest->data(), fLatest->size());
+    return out;
+}
+
+void BlobReceiver::reclaim()
+{
+    delete fRetired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void BlobReceiver::swapAtBlockBoundary()
+{
+    if (fPending.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    // Only one retired slot: if the last one has not been reclaimed yet, try again next block
+    if (fRetired.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    Blob *const incoming = fPending.exchange(nullptr, std::memory_order_acq_rel);
+    if (incoming == nullptr)
+        return;
+
+    if (fCurrent != nullptr)
+        fRetired.store(fCurrent, std::memory_order_release);
+
+    fCurrent = incoming;
+    fSwapCount.fetch_add(1, std::memory_order_release);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// BlobSender
+
+BlobSender::BlobSender() :
+    fQuit(false),
+    fHasQueuedBlob(false),
+    fEncoding(false),
+    fNextId(1)
+{
+    // Worker is started by the first send(), most editors never send a blob
+}
+
+BlobSender::~BlobSender()
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+    fCondition.notify_one();
+
+    // Returns within one chunk's encoding time, the worker checks fQuit between chunks
+    if (fWorker.joinable())
+        fWorker.join();
+}
+
+void BlobSender::send(std::vector<uint8_t> blob)
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+
+        fQueuedBlob = std::move(blob);
+        fHasQueuedBlob = true;
+
+        // Superseded. The receiver drops any partial blob when the next one starts.
+        fChunks.clear();
+
+        if (!fWorker.joinable())
+            fWorker = std::thread(&BlobSender::_workerLoop, this);
+    }
+    fCondition.notify_one();
+}
+
+void BlobSender::pump(const std::function<void(const char *, const char *)> &setState, uint32_t maxChunks)
+{
+    for (uint32_t i = 0; i < maxChunks; ++i)
+    {
+        std::string chunk;
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            if (fChunks.empty())
+                return;
+
+            chunk = std::move(fChunks.front());
+            fChunks.pop_front();
+        }
+
+        setState(BLOB_TRANSFER_STATE_KEY, chunk.c_str());
+    }
+}
+
+bool BlobSender::isBusy() const
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fHasQueuedBlob || fEncoding || !fChunks.empty();
+}
+
+void BlobSender::_workerLoop()
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+
+    for (;;)
+    {
+        fCondition.wait(lock, [this] { return fQuit || fHasQueuedBlob; });
+        if (fQuit)
+            return;
+
+        std::vector<uint8_t> blob = std::move(fQueuedBlob);
+        fQueuedBlob = std::vector<uint8_t>();
+        fHasQueuedBlob = false;
+        fEncoding = true;
+
+        const uint32_t id = fNextId++;
+
+        // Encode without holding the lock
+        lock.unlock();
+
+        const uint32_t count = blob.empty() ? 1 : (uint32_t)((blob.size() + kChunkBytes - 1) / kChunkBytes);
+        std::deque<std::string> chunks;
+        bool abandoned = false;
+
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            // Stop early when closing, or when a newer blob makes this one pointless
+            lock.lock();
+            abandoned = fQuit || fHasQueuedBlob;
+            lock.unlock();
+
+            if (abandoned)
+                break;
+
+            const size_t offset = (size_t)index * kChunkBytes;
+            const size_t length = std::min(kChunkBytes, blob.size() - offset);
+
+            std::string chunk = format_chunk_header(id, index, count, blob.size());
+            base64_encode(chunk, blob.data() + offset, length);
+            chunks.push_back(std::move(chunk));
+        }
+
+        lock.lock();
+        fEncoding = false;
+
+        // Throw the result away if a newer blob arrived meanwhile
+        if (!abandoned && !fHasQueuedBlob)
+            fChunks = std::move(chunks);
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ *  blob_transfer.hpp - Non-blocking transfer of large blobs from UI to DSP
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Large payloads (wavetables, IRs, sample maps) travel over DPF state, which
+ * only carries strings. So:
+ *
+ *   UI:  BlobSender base64-encodes and splits the blob on a worker thread.
+ *        uiIdle() hands a few chunks per tick to UI::setState(), so the host
+ *        never sees one giant message.
+ *
+ *   DSP: Plugin::setState() runs on a non-realtime thread and feeds chunks to
+ *        BlobReceiver, which assembles them into a buffer allocated there.
+ *        A completed blob is published as a pointer. run() picks it up at a
+ *        block boundary with a single atomic exchange. The blob it replaces is
+ *        freed by a reclaimer thread, which polls for the swap while one is
+ *        outstanding, and sleeps otherwise.
+ *
+ * A chunk looks like "<id>:<index>:<count>:<total bytes>:<base64 payload>".
+ * When the host restores state it passes the whole blob as one chunk
+ * (index 0, count 1), which goes through the same path.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// State key used for blob chunks
+#define BLOB_TRANSFER_STATE_KEY "blob"
+
+/**
+ * A fully received blob.
+ * The audio thread only reads data/size, it never owns or frees a Blob.
+ */
+struct Blob {
+    uint32_t id = 0;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    // Keeps the bytes alive. Shared with BlobReceiver's copy for getState().
+    std::shared_ptr<const std::vector<uint8_t>> bytes;
+};
+
+// ------------------------------------------------------------------------------------------------------------
+
+class BlobReceiver {
+public:
+    BlobReceiver();
+    ~BlobReceiver();
+
+    // Non-realtime: feed one chunk. Returns false if it was malformed or out of sequence.
+    bool receiveChunk(const char *value);
+
+    // Non-realtime: the latest complete blob as a single chunk, for the host to save.
+    std::string encodeLatest() const;
+
+    // Non-realtime: free the blob the audio thread swapped out. The reclaimer thread
+    // does this shortly after the swap; calling it earlier does no harm.
+    void reclaim();
+
+    // Realtime: swap in a pending blob, if any. Call at the start of run().
+    // Lock-free and allocation-free: a couple of pointer exchanges.
+    void swapAtBlockBoundary();
+
+    // Realtime: blob in use by the audio thread, or nullptr.
+    const Blob *current() const { return fCurrent; }
+
+private:
+    void _publish(std::shared_ptr<const std::vector<uint8_t>> bytes, uint32_t id);
+    void _reclaimLoop();
+    bool _isSwapOutstanding() const;
+
+    // Non-realtime side, serialises setState()/getState() which may come from different threads
+    mutable std::mutex fMutex;
+    uint32_t fStagingId;
+    uint32_t fStagingNext;
+    uint32_t fStagingCount;
+    size_t fStagingTotal;
+    std::vector<uint8_t> fStaging;
+    std::shared_ptr<const std::vector<uint8_t>> fLatest;
+    uint32_t fLatestId;
+
+    // Hand-over between the two sides
+    std::atomic<Blob *> fPending;   // Set by non-realtime side, taken by audio thread
+    std::atomic<Blob *> fRetired;   // Set by audio thread (only when empty), freed by non-realtime side
+    std::atomic<uint32_t> fSwapCount;   // Counted by audio thread after setting fRetired
+
+    // Reclaimer thread, started by the first published blob
+    std::thread fReclaimer;
+    std::mutex fReclaimMutex;
+    std::condition_variable fReclaimCondition;
+    bool fReclaimQuit;
+    uint32_t fExpectedSwaps;    // Published blobs not dropped before the audio thread took them
+
+    // Audio thread only
+    Blob *fCurrent;
+};
+
+// ------------------------------------------------------------------------------------------------------------
+
+class BlobSender {
+public:
+    BlobSender();
+    ~BlobSender();
+
+    // Any thread: send a blob. Encoding happens on a worker thread.
+    // A newer blob supersedes chunks of an older one which have not gone out yet.
+    void send(std::vector<uint8_t> blob);
+
+    // UI thread: pass at most maxChunks prepared chunks to setState(key, value).
+    void pump(const std::function<void(const char *, const char *)> &setState, uint32_t maxChunks);
+
+    // True while chunks are still being prepared or waiting to be sent
+    bool isBusy() const;
+
+private:
+    void _workerLoop();
+
+    std::thread fWorker;
+    mutable std::mutex fMutex;
+    std::condition_variable fCondition;
+    bool fQuit;
+
+    std::vector<uint8_t> fQueuedBlob;   // Waiting to be encoded
+    bool fHasQueuedBlob;
+    bool fEncoding;
+    std::deque<std::string> fChunks;    // Ready to go out
+    uint32_t fNextId;
+};
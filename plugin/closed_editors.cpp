@@ -0,0 +1,91 @@
+/*
+ *  closed_editors.cpp - Drawing threads and windows of closed editors, retired off the close path
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "closed_editors.hpp"
+#include "trace.hpp"
+
+ClosedEditorList &ClosedEditorList::instance()
+{
+    static ClosedEditorList list;
+    return list;
+}
+
+ClosedEditorList::~ClosedEditorList()
+{
+    // Nobody called shutdown(). Without waiting, everything is left behind.
+    for (Entry &entry : fEntries)
+        entry.thread.detach();
+}
+
+void ClosedEditorList::add(std::thread thread, std::shared_ptr<ClosingEditor> editor)
+{
+    fEntries.push_back({ std::move(thread), std::move(editor) });
+}
+
+size_t ClosedEditorList::sweep(size_t maxCount, bool keepWarm)
+{
+    size_t count = 0;
+
+    for (auto it = fEntries.begin(); it != fEntries.end() && count < maxCount; )
+    {
+        if (it->editor->isFinished())
+        {
+            TRACE_SCOPE("Retire closed editor");
+
+            it->thread.join();
+            it->editor->retire(keepWarm);
+            it = fEntries.erase(it);
+            ++count;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return count;
+}
+
+size_t ClosedEditorList::shutdown(std::chrono::milliseconds timeout)
+{
+    TRACE_SCOPE("Shut down closed editors");
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    size_t leftBehind = 0;
+
+    for (Entry &entry : fEntries)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const auto remaining = now < deadline
+            ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now)
+            : std::chrono::milliseconds(0);
+
+        if (entry.editor->waitFinished(remaining))
+        {
+            entry.thread.join();
+            entry.editor->retire(false);
+        }
+        else
+        {
+            // Still running on its own reference to the editor, see ClosingEditor
+            entry.thread.detach();
+            ++leftBehind;
+        }
+    }
+
+    fEntries.clear();
+    return leftBehind;
+}
@@ -0,0 +1,91 @@
+/*
+ *  closed_editors.hpp - Drawing threads and windows of closed editors, retired off the close path
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Hosts close editors from their main thread, often many at once (closing a
+ * project), and stall meanwhile. So closing an editor only asks its drawing
+ * thread to stop and waits for it at most kCloseTimeout. A frame may be stuck
+ * in a vsync swap on a hidden window, or in a slow driver. Then the editor
+ * takes its window out of the host window and hands it over to this list,
+ * with the drawing thread, finished or not.
+ *
+ * Joining the thread and destroying or pooling the window happen later, once
+ * the thread has finished: one editor per uiIdle() tick of any other editor,
+ * or all finished ones when an editor opens. No host call pays for more than
+ * that.
+ *
+ * At library unload, shutdown() waits for the rest, up to kUnloadTimeout in
+ * total. A thread still running by then is detached instead of joined, which
+ * could hang the host's unload forever. Its editor is not retired.
+ *
+ * All functions must be called from the main thread.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Implemented by EditorSession. The drawing thread must hold its own reference
+ * to the editor, as a thread left behind at unload outlives the list's.
+ */
+class ClosingEditor {
+public:
+    virtual ~ClosingEditor() = default;
+
+    virtual bool isFinished() const = 0;
+    virtual bool waitFinished(std::chrono::milliseconds timeout) const = 0;
+
+    // Destroy or park what the finished drawing thread left behind.
+    // keepWarm allows parking it in the window pool.
+    virtual void retire(bool keepWarm) = 0;
+};
+
+class ClosedEditorList {
+public:
+    // Covers a couple of vsync frames, which is where a healthy thread could be stuck
+    static constexpr std::chrono::milliseconds kCloseTimeout{50};
+    static constexpr std::chrono::milliseconds kUnloadTimeout{200};
+
+    static ClosedEditorList &instance();
+
+    ~ClosedEditorList();
+
+    void add(std::thread thread, std::shared_ptr<ClosingEditor> editor);
+
+    // Join and retire at most maxCount editors whose drawing thread has finished. Returns how many.
+    size_t sweep(size_t maxCount, bool keepWarm);
+
+    // Retire all editors, waiting at most timeout in total, without keeping any warm.
+    // Returns how many threads missed the deadline and were detached.
+    size_t shutdown(std::chrono::milliseconds timeout);
+
+    size_t size() const { return fEntries.size(); }
+
+private:
+    struct Entry {
+        std::thread thread;
+        std::shared_ptr<ClosingEditor> editor;
+    };
+
+    ClosedEditorList() = default;
+
+    std::vector<Entry> fEntries;
+};
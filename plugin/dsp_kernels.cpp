@@ -0,0 +1,588 @@
+/*
+ *  dsp_kernels.cpp - Runtime-dispatched SIMD kernels for the audio thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "dsp_kernels.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+/**
+ * SIMD variants are compiled with per-function target attributes, so the
+ * rest of the plugin keeps the baseline ISA and we need no extra compiler
+ * flags. That's a GCC/Clang feature; other compilers only get scalar (and
+ * SSE2, which is baseline on x86-64).
+ *
+ * This file must be built with -ffp-contract=off (see CMakeLists.txt):
+ * avx512f implies FMA, and GCC would otherwise fuse our separate mul/add
+ * intrinsics, breaking bit-exactness with the scalar reference.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+# define DSP_KERNELS_X86 1
+# include <immintrin.h>
+# define DSP_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_M_X64)
+# define DSP_KERNELS_SSE2_ONLY 1
+# include <emmintrin.h>
+# define DSP_TARGET(isa)
+#endif
+
+#if DSP_KERNELS_X86 || DSP_KERNELS_SSE2_ONLY
+# define DSP_KERNELS_HAVE_SSE2 1
+#endif
+
+// ------------------------------------------------------------------------------------------------------------
+// Scalar reference
+
+static void scalar_copy(float* dst, const float* src, uint32_t frames)
+{
+    if (dst != src)
+        std::memmove(dst, src, sizeof(float) * frames);
+}
+
+static void scalar_gain(float* dst, const float* src, float gain, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+        dst[i] = src[i] * gain;
+}
+
+static void scalar_gain_ramp(float* dst, const float* src, float start, float end, uint32_t frames)
+{
+    const float step = frames > 0 ? (end - start) / (float)frames : 0.0f;
+
+    for (uint32_t i = 0; i < frames; ++i)
+        dst[i] = src[i] * (start + step * (float)i);
+}
+
+static void scalar_pan(float* left, float* right, const float* src, float gainL, float gainR, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        const float s = src[i];
+        left[i] = s * gainL;
+        right[i] = s * gainR;
+    }
+}
+
+static void scalar_mix_stereo(float* left, float* right, const float* srcL, const float* srcR, float gain, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        left[i] += srcL[i] * gain;
+        right[i] += srcR[i] * gain;
+    }
+}
+
+static void scalar_sum(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+        dst[i] = a[i] + b[i];
+}
+
+static void scalar_multiply_add(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+        dst[i] += a[i] * b[i];
+}
+
+static float scalar_peak(const float* src, uint32_t frames)
+{
+    float peak = 0.0f;
+
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        const float a = std::fabs(src[i]);
+        if (a > peak)
+            peak = a;
+    }
+
+    return peak;
+}
+
+static void scalar_flush_denormals(float* buf, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        if (std::fabs(buf[i]) < FLT_MIN)
+            buf[i] = 0.0f;
+    }
+}
+
+static const DspKernels kScalarKernels = {
+    "scalar",
+    scalar_copy,
+    scalar_gain,
+    scalar_gain_ramp,
+    scalar_pan,
+    scalar_mix_stereo,
+    scalar_sum,
+    scalar_multiply_add,
+    scalar_peak,
+    scalar_flush_denormals,
+};
+
+// ------------------------------------------------------------------------------------------------------------
+// SSE2
+
+#if DSP_KERNELS_HAVE_SSE2
+
+DSP_TARGET("sse2") static void sse2_gain(float* dst, const float* src, float gain, uint32_t frames)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+
+    scalar_gain(dst + i, src + i, gain, frames - i);
+}
+
+DSP_TARGET("sse2") static void sse2_gain_ramp(float* dst, const float* src, float start, float end, uint32_t frames)
+{
+    const float step = frames > 0 ? (end - start) / (float)frames : 0.0f;
+    const __m128 vstart = _mm_set1_ps(start);
+    const __m128 vstep = _mm_set1_ps(step);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        const __m128 g = _mm_add_ps(vstart, _mm_mul_ps(vstep, index));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        index = _mm_add_ps(index, four);
+    }
+
+    for (; i < frames; ++i)
+        dst[i] = src[i] * (start + step * (float)i);
+}
+
+DSP_TARGET("sse2") static void sse2_pan(float* left, float* right, const float* src, float gainL, float gainR, uint32_t frames)
+{
+    const __m128 gl = _mm_set1_ps(gainL);
+    const __m128 gr = _mm_set1_ps(gainR);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        const __m128 s = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(left + i, _mm_mul_ps(s, gl));
+        _mm_storeu_ps(right + i, _mm_mul_ps(s, gr));
+    }
+
+    scalar_pan(left + i, right + i, src + i, gainL, gainR, frames - i);
+}
+
+DSP_TARGET("sse2") static void sse2_mix_stereo(float* left, float* right, const float* srcL, const float* srcR, float gain, uint32_t frames)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(_mm_loadu_ps(srcL + i), g)));
+        _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(_mm_loadu_ps(srcR + i), g)));
+    }
+
+    scalar_mix_stereo(left + i, right + i, srcL + i, srcR + i, gain, frames - i);
+}
+
+DSP_TARGET("sse2") static void sse2_sum(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    scalar_sum(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("sse2") static void sse2_multiply_add(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))));
+
+    scalar_multiply_add(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("sse2") static float sse2_peak(const float* src, uint32_t frames)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(src + i), absMask));
+
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    const float tail = scalar_peak(src + i, frames - i);
+    const float head = _mm_cvtss_f32(peak);
+    return tail > head ? tail : head;
+}
+
+DSP_TARGET("sse2") static void sse2_flush_denormals(float* buf, uint32_t frames)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 smallest = _mm_set1_ps(FLT_MIN);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(buf + i);
+        const __m128 tiny = _mm_cmplt_ps(_mm_and_ps(x, absMask), smallest);
+        _mm_storeu_ps(buf + i, _mm_andnot_ps(tiny, x));
+    }
+
+    scalar_flush_denormals(buf + i, frames - i);
+}
+
+static const DspKernels kSse2Kernels = {
+    "sse2",
+    scalar_copy,        // memmove is already vectorised by libc
+    sse2_gain,
+    sse2_gain_ramp,
+    sse2_pan,
+    sse2_mix_stereo,
+    sse2_sum,
+    sse2_multiply_add,
+    sse2_peak,
+    sse2_flush_denormals,
+};
+
+#endif // DSP_KERNELS_HAVE_SSE2
+
+// ------------------------------------------------------------------------------------------------------------
+// AVX2
+
+#if DSP_KERNELS_X86
+
+DSP_TARGET("avx2") static void avx2_gain(float* dst, const float* src, float gain, uint32_t frames)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+
+    scalar_gain(dst + i, src + i, gain, frames - i);
+}
+
+DSP_TARGET("avx2") static void avx2_gain_ramp(float* dst, const float* src, float start, float end, uint32_t frames)
+{
+    const float step = frames > 0 ? (end - start) / (float)frames : 0.0f;
+    const __m256 vstart = _mm256_set1_ps(start);
+    const __m256 vstep = _mm256_set1_ps(step);
+    __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        const __m256 g = _mm256_add_ps(vstart, _mm256_mul_ps(vstep, index));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+        index = _mm256_add_ps(index, eight);
+    }
+
+    for (; i < frames; ++i)
+        dst[i] = src[i] * (start + step * (float)i);
+}
+
+DSP_TARGET("avx2") static void avx2_pan(float* left, float* right, const float* src, float gainL, float gainR, uint32_t frames)
+{
+    const __m256 gl = _mm256_set1_ps(gainL);
+    const __m256 gr = _mm256_set1_ps(gainR);
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        const __m256 s = _mm256_loadu_ps(src + i);
+        _mm256_storeu_ps(left + i, _mm256_mul_ps(s, gl));
+        _mm256_storeu_ps(right + i, _mm256_mul_ps(s, gr));
+    }
+
+    scalar_pan(left + i, right + i, src + i, gainL, gainR, frames - i);
+}
+
+DSP_TARGET("avx2") static void avx2_mix_stereo(float* left, float* right, const float* srcL, const float* srcR, float gain, uint32_t frames)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        _mm256_storeu_ps(left + i, _mm256_add_ps(_mm256_loadu_ps(left + i), _mm256_mul_ps(_mm256_loadu_ps(srcL + i), g)));
+        _mm256_storeu_ps(right + i, _mm256_add_ps(_mm256_loadu_ps(right + i), _mm256_mul_ps(_mm256_loadu_ps(srcR + i), g)));
+    }
+
+    scalar_mix_stereo(left + i, right + i, srcL + i, srcR + i, gain, frames - i);
+}
+
+DSP_TARGET("avx2") static void avx2_sum(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+
+    scalar_sum(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("avx2") static void avx2_multiply_add(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    // Separate mul and add on purpose: FMA would round differently from the scalar reference
+    for (; i + 8 <= frames; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+
+    scalar_multiply_add(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("avx2") static float avx2_peak(const float* src, uint32_t frames)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+        peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(src + i), absMask));
+
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    const float tail = scalar_peak(src + i, frames - i);
+    const float head = _mm_cvtss_f32(half);
+    return tail > head ? tail : head;
+}
+
+DSP_TARGET("avx2") static void avx2_flush_denormals(float* buf, uint32_t frames)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 smallest = _mm256_set1_ps(FLT_MIN);
+    uint32_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(buf + i);
+        const __m256 tiny = _mm256_cmp_ps(_mm256_and_ps(x, absMask), smallest, _CMP_LT_OQ);
+        _mm256_storeu_ps(buf + i, _mm256_andnot_ps(tiny, x));
+    }
+
+    scalar_flush_denormals(buf + i, frames - i);
+}
+
+static const DspKernels kAvx2Kernels = {
+    "avx2",
+    scalar_copy,
+    avx2_gain,
+    avx2_gain_ramp,
+    avx2_pan,
+    avx2_mix_stereo,
+    avx2_sum,
+    avx2_multiply_add,
+    avx2_peak,
+    avx2_flush_denormals,
+};
+
+// ------------------------------------------------------------------------------------------------------------
+// AVX-512
+
+DSP_TARGET("avx512f") static void avx512_gain(float* dst, const float* src, float gain, uint32_t frames)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), g));
+
+    avx2_gain(dst + i, src + i, gain, frames - i);
+}
+
+DSP_TARGET("avx512f") static void avx512_gain_ramp(float* dst, const float* src, float start, float end, uint32_t frames)
+{
+    const float step = frames > 0 ? (end - start) / (float)frames : 0.0f;
+    const __m512 vstart = _mm512_set1_ps(start);
+    const __m512 vstep = _mm512_set1_ps(step);
+    __m512 index = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                  8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    const __m512 sixteen = _mm512_set1_ps(16.0f);
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        const __m512 g = _mm512_add_ps(vstart, _mm512_mul_ps(vstep, index));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), g));
+        index = _mm512_add_ps(index, sixteen);
+    }
+
+    for (; i < frames; ++i)
+        dst[i] = src[i] * (start + step * (float)i);
+}
+
+DSP_TARGET("avx512f") static void avx512_pan(float* left, float* right, const float* src, float gainL, float gainR, uint32_t frames)
+{
+    const __m512 gl = _mm512_set1_ps(gainL);
+    const __m512 gr = _mm512_set1_ps(gainR);
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        const __m512 s = _mm512_loadu_ps(src + i);
+        _mm512_storeu_ps(left + i, _mm512_mul_ps(s, gl));
+        _mm512_storeu_ps(right + i, _mm512_mul_ps(s, gr));
+    }
+
+    avx2_pan(left + i, right + i, src + i, gainL, gainR, frames - i);
+}
+
+DSP_TARGET("avx512f") static void avx512_mix_stereo(float* left, float* right, const float* srcL, const float* srcR, float gain, uint32_t frames)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        _mm512_storeu_ps(left + i, _mm512_add_ps(_mm512_loadu_ps(left + i), _mm512_mul_ps(_mm512_loadu_ps(srcL + i), g)));
+        _mm512_storeu_ps(right + i, _mm512_add_ps(_mm512_loadu_ps(right + i), _mm512_mul_ps(_mm512_loadu_ps(srcR + i), g)));
+    }
+
+    avx2_mix_stereo(left + i, right + i, srcL + i, srcR + i, gain, frames - i);
+}
+
+DSP_TARGET("avx512f") static void avx512_sum(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+
+    avx2_sum(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("avx512f") static void avx512_multiply_add(float* dst, const float* a, const float* b, uint32_t frames)
+{
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_mul_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+
+    avx2_multiply_add(dst + i, a + i, b + i, frames - i);
+}
+
+DSP_TARGET("avx512f") static float avx512_peak(const float* src, uint32_t frames)
+{
+    const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+    __m512 peak = _mm512_setzero_ps();
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        const __m512 x = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(_mm512_loadu_ps(src + i)), absMask));
+        peak = _mm512_maskz_max_ps(0xffff, peak, x);     // Unmasked form trips -Wuninitialized in GCC's headers
+    }
+
+    // Fold down to 256 bits and let the AVX2 kernel finish, tail included
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, peak);
+
+    const float tail = avx2_peak(src + i, frames - i);
+    const float head = avx2_peak(lanes, 16);
+    return tail > head ? tail : head;
+}
+
+DSP_TARGET("avx512f") static void avx512_flush_denormals(float* buf, uint32_t frames)
+{
+    const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+    const __m512 smallest = _mm512_set1_ps(FLT_MIN);
+    uint32_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        const __m512 x = _mm512_loadu_ps(buf + i);
+        const __m512 a = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), absMask));
+        const __mmask16 normal = _mm512_cmp_ps_mask(a, smallest, _CMP_GE_OQ);
+        _mm512_storeu_ps(buf + i, _mm512_maskz_mov_ps(normal, x));
+    }
+
+    avx2_flush_denormals(buf + i, frames - i);
+}
+
+static const DspKernels kAvx512Kernels = {
+    "avx512",
+    scalar_copy,
+    avx512_gain,
+    avx512_gain_ramp,
+    avx512_pan,
+    avx512_mix_stereo,
+    avx512_sum,
+    avx512_multiply_add,
+    avx512_peak,
+    avx512_flush_denormals,
+};
+
+#endif // DSP_KERNELS_X86
+
+// ------------------------------------------------------------------------------------------------------------
+// Dispatch
+
+const DspKernels* dsp_kernels_find(const char* name)
+{
+    if (std::strcmp(name, "scalar") == 0)
+        return &kScalarKernels;
+
+#if DSP_KERNELS_X86
+    __builtin_cpu_init();
+
+    if (std::strcmp(name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2") ? &kSse2Kernels : nullptr;
+    if (std::strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+    if (std::strcmp(name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f") ? &kAvx512Kernels : nullptr;
+#elif DSP_KERNELS_SSE2_ONLY
+    if (std::strcmp(name, "sse2") == 0)
+        return &kSse2Kernels;
+#endif
+
+    return nullptr;
+}
+
+static const DspKernels* select_dsp_kernels()
+{
+    // Best first
+    static const char* const kPreference[] = { "avx512", "avx2", "sse2" };
+
+    for (const char* name : kPreference)
+    {
+        if (const DspKernels* kernels = dsp_kernels_find(name))
+            return kernels;
+    }
+
+    return &kScalarKernels;
+}
+
+// Resolved during static initialisation, so the audio thread never runs CPUID
+static const DspKernels* const gDspKernels = select_dsp_kernels();
+
+const DspKernels& dsp_kernels()
+{
+    return *gDspKernels;
+}
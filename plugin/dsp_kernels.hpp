@@ -0,0 +1,69 @@
+/*
+ *  dsp_kernels.hpp - Runtime-dispatched SIMD kernels for the audio thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * A table of block processing kernels.
+ *
+ * There is one table per instruction set (scalar, SSE2, AVX2, AVX-512). The
+ * best one supported by the CPU is picked once at load time via CPUID, so the
+ * audio thread only pays an indirect call per block.
+ *
+ * All variants perform the same float operations in the same order (no FMA),
+ * so their results are bit-identical to the scalar reference.
+ *
+ * Buffers need no special alignment. dst may alias src for every
+ * element-wise kernel.
+ */
+struct DspKernels {
+    const char* name;
+
+    // dst[i] = src[i]
+    void (*copy)(float* dst, const float* src, uint32_t frames);
+
+    // dst[i] = src[i] * gain
+    void (*gain)(float* dst, const float* src, float gain, uint32_t frames);
+
+    // dst[i] = src[i] * (start + (end - start) * i / frames)
+    void (*gainRamp)(float* dst, const float* src, float start, float end, uint32_t frames);
+
+    // Mono to stereo: left[i] = src[i] * gainL, right[i] = src[i] * gainR
+    void (*pan)(float* left, float* right, const float* src, float gainL, float gainR, uint32_t frames);
+
+    // Stereo mix into a bus: left[i] += srcL[i] * gain, right[i] += srcR[i] * gain
+    void (*mixStereo)(float* left, float* right, const float* srcL, const float* srcR, float gain, uint32_t frames);
+
+    // dst[i] = a[i] + b[i]
+    void (*sum)(float* dst, const float* a, const float* b, uint32_t frames);
+
+    // dst[i] += a[i] * b[i]
+    void (*multiplyAdd)(float* dst, const float* a, const float* b, uint32_t frames);
+
+    // max(|src[i]|)
+    float (*peak)(const float* src, uint32_t frames);
+
+    // Replace denormals (and -0.0f) with 0.0f
+    void (*flushDenormals)(float* buf, uint32_t frames);
+};
+
+// Best kernels for this CPU, chosen at load time.
+const DspKernels& dsp_kernels();
+
+// Kernels by name ("scalar", "sse2", "avx2", "avx512"). Returns nullptr if unsupported by this CPU or build.
+const DspKernels* dsp_kernels_find(const char* name);
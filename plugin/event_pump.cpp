@@ -0,0 +1,96 @@
+/*
+ *  event_pump.cpp - One GLFW event pump for all editors of the process
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "event_pump.hpp"
+#include "monotonic_clock.hpp"
+#include "trace.hpp"
+
+#include "DistrhoUtils.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+EditorEventPump &EditorEventPump::instance()
+{
+    static EditorEventPump pump;
+    return pump;
+}
+
+void EditorEventPump::subscribe(const void *editor)
+{
+    // First tick polls right away, see pump()
+    fSubscribers.push_back({ editor, true });
+    fMaxSubscribers = std::max(fMaxSubscribers, fSubscribers.size());
+}
+
+void EditorEventPump::unsubscribe(const void *editor)
+{
+    fSubscribers.erase(std::remove_if(fSubscribers.begin(), fSubscribers.end(),
+                                      [editor](const Subscriber &s) { return s.editor == editor; }),
+                       fSubscribers.end());
+
+    if (fSubscribers.empty())
+        _reportAndReset();
+}
+
+bool EditorEventPump::pump(const void *editor)
+{
+    auto self = std::find_if(fSubscribers.begin(), fSubscribers.end(),
+                             [editor](const Subscriber &s) { return s.editor == editor; });
+    if (self == fSubscribers.end())
+        return false;
+
+    ++fIdleCalls;
+
+    // Somebody else has polled since we last idled: this tick is covered
+    if (!self->idledSincePoll)
+    {
+        self->idledSincePoll = true;
+        return false;
+    }
+
+    const uint64_t startNs = monotonic_now_ns();
+    {
+        TRACE_SCOPE("glfwPollEvents");
+        glfwPollEvents();
+    }
+    fPollNs += monotonic_now_ns() - startNs;
+    ++fPolls;
+
+    TRACE_COUNTER("Editors sharing event pump", (double)fSubscribers.size());
+
+    // A close callback may have got the host to destroy an editor meanwhile, so `self` may be stale
+    for (Subscriber &s : fSubscribers)
+        s.idledSincePoll = s.editor == editor;
+
+    return true;
+}
+
+void EditorEventPump::_reportAndReset()
+{
+    if (fPolls > 0)
+    {
+        d_stdout("Event pump: %llu polls for %llu idle calls of up to %u editors, %.3f ms per poll",
+                 (unsigned long long)fPolls, (unsigned long long)fIdleCalls, (unsigned)fMaxSubscribers,
+                 (double)fPollNs / (double)fPolls / 1e6);
+    }
+
+    fMaxSubscribers = 0;
+    fIdleCalls = 0;
+    fPolls = 0;
+    fPollNs = 0;
+}
@@ -0,0 +1,70 @@
+/*
+ *  event_pump.hpp - One GLFW event pump for all editors of the process
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * glfwPollEvents() drains the event queue of the whole process, not of one
+ * window. With every editor polling in its own uiIdle(), N open editors poll N
+ * times per host idle tick, and all but the first find nothing to do.
+ *
+ * Editors subscribe to this pump instead and call pump() from uiIdle(). It
+ * polls once per round of idle calls: when an editor idles a second time since
+ * the last poll, a new tick has started. That's independent of the order the
+ * host idles editors in, and a stalled editor doesn't stop the others.
+ *
+ * Events need no routing of ours: GLFW dispatches them per window, and every
+ * window's user pointer leads to its EditorSession and owning UI.
+ *
+ * Subscriptions are reference counted, like GLFW initialisation. All functions
+ * must be called from the main thread.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class EditorEventPump {
+public:
+    static EditorEventPump &instance();
+
+    // An editor is open. `editor` identifies it in pump() calls.
+    void subscribe(const void *editor);
+    void unsubscribe(const void *editor);
+
+    // Idle tick of an editor. Returns true if this call polled events.
+    bool pump(const void *editor);
+
+    size_t getSubscriberCount() const { return fSubscribers.size(); }
+
+private:
+    struct Subscriber {
+        const void *editor;
+        bool idledSincePoll;
+    };
+
+    EditorEventPump() = default;
+
+    void _reportAndReset();
+
+    std::vector<Subscriber> fSubscribers;
+    size_t fMaxSubscribers = 0;
+
+    // Statistics of the current run, from first subscribe to last unsubscribe
+    uint64_t fIdleCalls = 0;
+    uint64_t fPolls = 0;
+    uint64_t fPollNs = 0;
+};
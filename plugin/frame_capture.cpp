@@ -0,0 +1,508 @@
+/*
+ *  frame_capture.cpp - Asynchronous capture of editor frames into shared memory
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "frame_capture.hpp"
+#include "monotonic_clock.hpp"
+
+#include "DistrhoUtils.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Not in GL 1.1 headers
+static constexpr GLenum kGlPixelPackBuffer = 0x88EB;
+static constexpr GLenum kGlStreamRead = 0x88E1;
+static constexpr GLenum kGlReadOnly = 0x88B8;
+static constexpr GLenum kGlBgra = 0x80E1;
+static constexpr GLenum kGlSyncGpuCommandsComplete = 0x9117;
+static constexpr GLenum kGlAlreadySignaled = 0x911A;
+static constexpr GLenum kGlConditionSatisfied = 0x911C;
+
+// GLsync is a pointer to an opaque struct, void * has the same ABI
+struct FrameCapture::GLFunctions {
+    void (*genBuffers)(GLsizei, GLuint *);
+    void (*deleteBuffers)(GLsizei, const GLuint *);
+    void (*bindBuffer)(GLenum, GLuint);
+    void (*bufferData)(GLenum, ptrdiff_t, const void *, GLenum);
+    void *(*mapBuffer)(GLenum, GLenum);
+    GLboolean (*unmapBuffer)(GLenum);
+
+    // Null without sync objects
+    void *(*fenceSync)(GLenum, GLbitfield);
+    GLenum (*clientWaitSync)(void *, GLbitfield, uint64_t);
+    void (*deleteSync)(void *);
+};
+
+template <typename Function>
+static bool load_gl_function(Function &function, const char *name)
+{
+    function = reinterpret_cast<Function>(glfwGetProcAddress(name));
+    return function != nullptr;
+}
+
+// Shared memory objects created by this process, for unique names
+static std::atomic<uint32_t> frame_capture_count { 0 };
+
+// ------------------------------------------------------------------------------------------------------------
+
+FrameCapture::FrameCapture() :
+    fNextReadback(0),
+    fFrame(0),
+    fShmFd(-1),
+    fShmSize(0),
+    fHeader(nullptr),
+    fPublishing(nullptr),
+    fPublishPixels(nullptr),
+    fPublishDone(false),
+    fPublishChanged(false),
+    fPublishNs(0),
+    fQuit(false)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    _stopPublisher();
+}
+
+bool FrameCapture::init(const char *name)
+{
+    const char *const version = (const char *)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version == nullptr || std::sscanf(version, "%d.%d", &major, &minor) != 2)
+        return false;
+
+    std::unique_ptr<GLFunctions> gl(new GLFunctions());
+
+    // Pixel buffer objects: core since 2.1, or buffer objects (1.5) plus ARB_pixel_buffer_object
+    const bool hasPixelBuffers = major > 2 || (major == 2 && minor >= 1) ||
+                                 ((major > 1 || minor >= 5) && glfwExtensionSupported("GL_ARB_pixel_buffer_object"));
+
+    const bool ok = hasPixelBuffers &&
+                    load_gl_function(gl->genBuffers, "glGenBuffers") &&
+                    load_gl_function(gl->deleteBuffers, "glDeleteBuffers") &&
+                    load_gl_function(gl->bindBuffer, "glBindBuffer") &&
+                    load_gl_function(gl->bufferData, "glBufferData") &&
+                    load_gl_function(gl->mapBuffer, "glMapBuffer") &&
+                    load_gl_function(gl->unmapBuffer, "glUnmapBuffer");
+
+    if (!ok)
+    {
+        d_stderr2("Frame capture: GL %d.%d lacks pixel buffer objects, not capturing", major, minor);
+        return false;
+    }
+
+    // Sync objects: core since 3.2. Optional, see frame_capture.hpp.
+    if (major > 3 || (major == 3 && minor >= 2) || glfwExtensionSupported("GL_ARB_sync"))
+    {
+        if (!load_gl_function(gl->fenceSync, "glFenceSync") ||
+            !load_gl_function(gl->clientWaitSync, "glClientWaitSync") ||
+            !load_gl_function(gl->deleteSync, "glDeleteSync"))
+        {
+            gl->fenceSync = nullptr;
+        }
+    }
+
+    // One object per editor. POSIX wants a single leading slash and no others.
+    while (*name == '/')
+        ++name;
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "-%d-%u", (int)getpid(), (unsigned)++frame_capture_count);
+    fShmName = std::string("/") + name + suffix;
+
+    const size_t headerSize = (sizeof(FrameCaptureHeader) + 4095) & ~(size_t)4095;
+    const size_t slotSize = (size_t)kFrameCaptureMaxWidth * kFrameCaptureMaxHeight * 4;
+    fShmSize = headerSize + slotSize * kFrameCaptureSlots;
+
+    // Sparse: pages are only committed as frames get written
+    shm_unlink(fShmName.c_str());
+    fShmFd = shm_open(fShmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fShmFd < 0 || ftruncate(fShmFd, (off_t)fShmSize) != 0)
+    {
+        d_stderr2("Frame capture: cannot create shared memory %s", fShmName.c_str());
+        if (fShmFd >= 0)
+        {
+            close(fShmFd);
+            shm_unlink(fShmName.c_str());
+        }
+        fShmFd = -1;
+        return false;
+    }
+
+    void *const memory = mmap(nullptr, fShmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fShmFd, 0);
+    if (memory == MAP_FAILED)
+    {
+        d_stderr2("Frame capture: cannot map shared memory %s", fShmName.c_str());
+        close(fShmFd);
+        shm_unlink(fShmName.c_str());
+        fShmFd = -1;
+        return false;
+    }
+
+    // Fresh object is zeroed, which is a valid state for the atomics
+    FrameCaptureHeader *const header = static_cast<FrameCaptureHeader *>(memory);
+    header->version = kFrameCaptureVersion;
+    header->slotCount = kFrameCaptureSlots;
+    header->maxWidth = kFrameCaptureMaxWidth;
+    header->maxHeight = kFrameCaptureMaxHeight;
+    for (uint32_t i = 0; i < kFrameCaptureSlots; ++i)
+        header->slots[i].pixelOffset = headerSize + slotSize * i;
+
+    // Consumers wait for the magic before reading anything else
+    header->magic.store(kFrameCaptureMagic, std::memory_order_release);
+
+    fGL = std::move(gl);
+    for (Readback &readback : fReadbacks)
+        fGL->genBuffers(1, &readback.buffer);
+
+    fNextReadback = 0;
+    fFrame = 0;
+    fStats = FrameCaptureStats();
+    fHeader = header;
+
+    d_stdout("Frame capture: publishing frames to shared memory %s%s", fShmName.c_str(),
+             fGL->fenceSync != nullptr ? "" : " (no GL sync objects)");
+    return true;
+}
+
+void FrameCapture::shutdown()
+{
+    if (!isEnabled())
+        return;
+
+    // The publisher may still be reading a mapped buffer and writing shared memory
+    _finishPublish(true);
+    _stopPublisher();
+
+    for (Readback &readback : fReadbacks)
+    {
+        if (readback.fence != nullptr)
+            fGL->deleteSync(readback.fence);
+        fGL->deleteBuffers(1, &readback.buffer);
+        readback = Readback();
+    }
+
+    // Consumers keep their mapping, the name goes away
+    munmap(fHeader, fShmSize);
+    close(fShmFd);
+    shm_unlink(fShmName.c_str());
+
+    fHeader = nullptr;
+    fShmFd = -1;
+    fGL.reset();
+
+    const uint64_t calls = fStats.readbacks + fStats.dropped;
+    if (calls > 0)
+    {
+        const uint64_t publishes = fStats.published + fStats.unchanged;
+
+        d_stdout("Frame capture: %llu frames read back, %llu published, %llu unchanged, %llu dropped. "
+                 "Drawing thread %.3f ms per frame on average, %.3f ms at most. "
+                 "Publisher %.3f ms per frame on average, %.3f ms at most",
+                 (unsigned long long)fStats.readbacks, (unsigned long long)fStats.published,
+                 (unsigned long long)fStats.unchanged, (unsigned long long)fStats.dropped,
+                 (double)fStats.totalNs / (double)calls / 1e6, (double)fStats.maxNs / 1e6,
+                 publishes > 0 ? (double)fStats.publishNs / (double)publishes / 1e6 : 0.0,
+                 (double)fStats.maxPublishNs / 1e6);
+    }
+}
+
+void FrameCapture::capture(int width, int height)
+{
+    if (!isEnabled())
+        return;
+
+    const uint64_t startNs = monotonic_now_ns();
+
+    // Earlier frames which are done by now. Oldest first, never waiting.
+    _collect();
+
+    Readback &readback = fReadbacks[fNextReadback];
+
+    if (readback.pending || width <= 0 || height <= 0 ||
+        (uint32_t)width > kFrameCaptureMaxWidth || (uint32_t)height > kFrameCaptureMaxHeight)
+    {
+        // All buffers in flight, the GPU is behind. Better lose a frame than stall.
+        ++fStats.dropped;
+    }
+    else
+    {
+        const size_t bytes = (size_t)width * (size_t)height * 4;
+
+        fGL->bindBuffer(kGlPixelPackBuffer, readback.buffer);
+        if (readback.allocated < bytes)
+        {
+            fGL->bufferData(kGlPixelPackBuffer, (ptrdiff_t)bytes, nullptr, kGlStreamRead);
+            readback.allocated = bytes;
+        }
+
+        // Into the bound buffer: returns as soon as the copy is queued
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, width, height, kGlBgra, GL_UNSIGNED_BYTE, nullptr);
+        fGL->bindBuffer(kGlPixelPackBuffer, 0);
+
+        if (fGL->fenceSync != nullptr)
+            readback.fence = fGL->fenceSync(kGlSyncGpuCommandsComplete, 0);
+
+        readback.width = width;
+        readback.height = height;
+        readback.frame = ++fFrame;
+        readback.timestampNs = startNs;
+        readback.pending = true;
+
+        fNextReadback = (fNextReadback + 1) % kReadbackDepth;
+        ++fStats.readbacks;
+    }
+
+    const uint64_t elapsedNs = monotonic_now_ns() - startNs;
+    fStats.totalNs += elapsedNs;
+    if (elapsedNs > fStats.maxNs)
+        fStats.maxNs = elapsedNs;
+}
+
+bool FrameCapture::_isReady(const Readback &readback) const
+{
+    if (readback.fence != nullptr)
+    {
+        // Zero timeout: only ask
+        const GLenum result = fGL->clientWaitSync(readback.fence, 0, 0);
+        return result == kGlAlreadySignaled || result == kGlConditionSatisfied;
+    }
+
+    // No fences. A couple of frames later, the copy is practically always done.
+    return fFrame - readback.frame >= kReadbackFrames;
+}
+
+void FrameCapture::_collect()
+{
+    // One frame at a time, so they go out in order. Still busy: the next one waits.
+    if (!_finishPublish(false))
+        return;
+
+    for (uint32_t i = 0; i < kReadbackDepth; ++i)
+    {
+        Readback &readback = fReadbacks[(fNextReadback + i) % kReadbackDepth];
+        if (!readback.pending)
+            continue;
+
+        // Keep frames in order: nothing newer goes out before this one
+        if (!_isReady(readback))
+            break;
+
+        // Stays mapped while the publisher reads it. Other buffers can still take readbacks meanwhile.
+        fGL->bindBuffer(kGlPixelPackBuffer, readback.buffer);
+        const void *const pixels = fGL->mapBuffer(kGlPixelPackBuffer, kGlReadOnly);
+        fGL->bindBuffer(kGlPixelPackBuffer, 0);
+
+        if (pixels == nullptr)
+        {
+            _release(readback);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(fPublishMutex);
+            fPublishing = &readback;
+            fPublishPixels = static_cast<const uint8_t *>(pixels);
+            fPublishDone = false;
+
+            if (!fPublisher.joinable())
+                fPublisher = std::thread(&FrameCapture::_publisherLoop, this);
+        }
+        fPublishCondition.notify_all();
+        break;
+    }
+}
+
+/**
+ * Take back the buffer the publisher had, if it's done with it, or once it is
+ * if `wait`. Returns false if it's still busy.
+ */
+bool FrameCapture::_finishPublish(bool wait)
+{
+    Readback *readback;
+    bool changed;
+    uint64_t elapsedNs;
+
+    {
+        std::unique_lock<std::mutex> lock(fPublishMutex);
+        if (fPublishing == nullptr)
+            return true;
+
+        if (wait)
+            fPublishCondition.wait(lock, [this] { return fPublishDone; });
+        else if (!fPublishDone)
+            return false;
+
+        readback = fPublishing;
+        changed = fPublishChanged;
+        elapsedNs = fPublishNs;
+        fPublishing = nullptr;
+    }
+
+    if (changed)
+        ++fStats.published;
+    else
+        ++fStats.unchanged;
+
+    fStats.publishNs += elapsedNs;
+    if (elapsedNs > fStats.maxPublishNs)
+        fStats.maxPublishNs = elapsedNs;
+
+    fGL->bindBuffer(kGlPixelPackBuffer, readback->buffer);
+    fGL->unmapBuffer(kGlPixelPackBuffer);
+    fGL->bindBuffer(kGlPixelPackBuffer, 0);
+
+    _release(*readback);
+    return true;
+}
+
+// Buffer is unmapped: ready for the next readback
+void FrameCapture::_release(Readback &readback)
+{
+    if (readback.fence != nullptr)
+    {
+        fGL->deleteSync(readback.fence);
+        readback.fence = nullptr;
+    }
+    readback.pending = false;
+}
+
+void FrameCapture::_publisherLoop()
+{
+    std::unique_lock<std::mutex> lock(fPublishMutex);
+
+    for (;;)
+    {
+        fPublishCondition.wait(lock, [this] { return fQuit || (fPublishing != nullptr && !fPublishDone); });
+        if (fQuit)
+            return;
+
+        // The drawing thread leaves this readback alone until fPublishDone
+        const Readback &readback = *fPublishing;
+        const uint8_t *const pixels = fPublishPixels;
+        lock.unlock();
+
+        const uint64_t startNs = monotonic_now_ns();
+        const bool changed = _publish(pixels, readback.width, readback.height, readback.timestampNs);
+        const uint64_t elapsedNs = monotonic_now_ns() - startNs;
+
+        lock.lock();
+        fPublishChanged = changed;
+        fPublishNs = elapsedNs;
+        fPublishDone = true;
+        fPublishCondition.notify_all();
+    }
+}
+
+// Nothing may be in flight: see shutdown()
+void FrameCapture::_stopPublisher()
+{
+    {
+        std::lock_guard<std::mutex> lock(fPublishMutex);
+        fQuit = true;
+    }
+    fPublishCondition.notify_all();
+
+    if (fPublisher.joinable())
+        fPublisher.join();
+
+    fQuit = false;
+}
+
+/**
+ * Publisher thread: write a frame into the next slot, unless it's identical to
+ * the previous one. Returns whether it was written. `pixels` come from GL,
+ * bottom row first.
+ */
+bool FrameCapture::_publish(const uint8_t *pixels, int width, int height, uint64_t timestampNs)
+{
+    uint8_t *const base = reinterpret_cast<uint8_t *>(fHeader);
+    const size_t stride = (size_t)width * 4;
+
+    auto sourceRow = [=](int y) { return pixels + (size_t)(height - 1 - y) * stride; };
+
+    // We are the only writer
+    const uint64_t previous = fHeader->latest.load(std::memory_order_relaxed);
+
+    // Dirty rectangle against the previous frame, still in its slot. Inclusive bounds, top-left origin.
+    int top = 0, bottom = height - 1, left = 0, right = width - 1;
+
+    const FrameCaptureSlot *const previousSlot = previous != 0 ? &fHeader->slots[previous % kFrameCaptureSlots] : nullptr;
+    if (previousSlot != nullptr && previousSlot->width == (uint32_t)width && previousSlot->height == (uint32_t)height)
+    {
+        const uint8_t *const previousPixels = base + previousSlot->pixelOffset;
+
+        while (top < height && std::memcmp(sourceRow(top), previousPixels + (size_t)top * stride, stride) == 0)
+            ++top;
+
+        if (top == height)
+            return false;
+
+        while (bottom > top && std::memcmp(sourceRow(bottom), previousPixels + (size_t)bottom * stride, stride) == 0)
+            --bottom;
+
+        // Columns: only look as far in as the bounds found so far
+        left = width;
+        right = -1;
+        for (int y = top; y <= bottom; ++y)
+        {
+            const uint32_t *const a = reinterpret_cast<const uint32_t *>(sourceRow(y));
+            const uint32_t *const b = reinterpret_cast<const uint32_t *>(previousPixels + (size_t)y * stride);
+
+            int x = 0;
+            while (x < left && a[x] == b[x])
+                ++x;
+            left = x < left ? x : left;
+
+            x = width - 1;
+            while (x > right && a[x] == b[x])
+                --x;
+            right = x > right ? x : right;
+        }
+    }
+
+    const uint64_t sequence = previous + 1;
+    FrameCaptureSlot &slot = fHeader->slots[sequence % kFrameCaptureSlots];
+
+    // Seqlock: readers which see 0, or a different sequence after copying, try again
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint8_t *const destination = base + slot.pixelOffset;
+    for (int y = 0; y < height; ++y)
+        std::memcpy(destination + (size_t)y * stride, sourceRow(y), stride);
+
+    slot.timestampNs = timestampNs;
+    slot.width = (uint32_t)width;
+    slot.height = (uint32_t)height;
+    slot.stride = (uint32_t)stride;
+    slot.dirtyX = (uint32_t)left;
+    slot.dirtyY = (uint32_t)top;
+    slot.dirtyWidth = (uint32_t)(right - left + 1);
+    slot.dirtyHeight = (uint32_t)(bottom - top + 1);
+
+    slot.sequence.store(sequence, std::memory_order_release);
+    fHeader->latest.store(sequence, std::memory_order_release);
+
+    return true;
+}
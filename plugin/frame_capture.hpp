@@ -0,0 +1,140 @@
+/*
+ *  frame_capture.hpp - Asynchronous capture of editor frames into shared memory
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * For viewing or recording editors on headless machines. A plain
+ * glReadPixels() into client memory waits until the GPU has finished the
+ * frame, which stalls the drawing thread every frame.
+ *
+ * Instead, capture() runs after the frame has been rendered, before the swap:
+ *
+ *   1. glReadPixels() into the next of kReadbackDepth pixel buffer objects,
+ *      followed by a fence. Both return right away, the GPU copies later.
+ *   2. Readbacks whose fence has signalled, a frame or two later, get mapped
+ *      and handed to a publisher thread, one at a time. It compares them with
+ *      the previous frame to find the dirty rectangle, and copies them into the
+ *      shared memory ring when something changed. That's a few MB of memory
+ *      traffic per frame, which the drawing thread no longer pays.
+ *   3. Once the publisher is done with a buffer, a later capture() unmaps it:
+ *      GL calls stay on the drawing thread.
+ *
+ * capture() never waits for the GPU or the publisher. If all buffers are still
+ * in flight, the frame is dropped. Without fences (GL < 3.2, no ARB_sync), a readback is
+ * assumed to be done once kReadbackFrames newer frames were issued.
+ *
+ * The shared memory layout is in frame_capture_shm.hpp.
+ *
+ * Only built with -DGLFW_BACKEND_FRAME_CAPTURE=ON (Linux only), and only used
+ * when GLFW_BACKEND_CAPTURE=<name> is set in the environment. Every editor
+ * gets its own object, /<name>-<pid>-<n>, which is logged when created.
+ *
+ * All functions must be called from the drawing thread, with the GL context current.
+ */
+
+#pragma once
+
+#include "frame_capture_shm.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct FrameCaptureStats {
+    uint64_t readbacks = 0;         // Frames read back from GL
+    uint64_t published = 0;         // Frames which changed, written to shared memory
+    uint64_t unchanged = 0;         // Frames identical to the previous one
+    uint64_t dropped = 0;           // Frames skipped: GPU behind, or frame too large
+    uint64_t totalNs = 0;           // Time spent in capture()
+    uint64_t maxNs = 0;
+    uint64_t publishNs = 0;         // Time spent comparing and copying, on the publisher thread
+    uint64_t maxPublishNs = 0;
+};
+
+class FrameCapture {
+public:
+    // Frames a readback may take on the GPU, plus one buffer with the publisher and one to read into
+    static constexpr uint32_t kReadbackFrames = 2;
+    static constexpr uint32_t kReadbackDepth = kReadbackFrames + 2;
+
+    FrameCapture();
+    ~FrameCapture();
+
+    // Returns false if GL lacks pixel buffer objects or shared memory can't be set up
+    bool init(const char *name);
+    void shutdown();
+
+    bool isEnabled() const { return fHeader != nullptr; }
+
+    // After rendering into the back buffer, before swapping
+    void capture(int width, int height);
+
+    const FrameCaptureStats &getStats() const { return fStats; }
+
+private:
+    struct Readback {
+        GLuint buffer = 0;
+        void *fence = nullptr;      // GLsync
+        int width = 0;
+        int height = 0;
+        size_t allocated = 0;
+        uint64_t frame = 0;
+        uint64_t timestampNs = 0;
+        bool pending = false;       // Read back, until unmapped after publishing
+    };
+
+    bool _isReady(const Readback &readback) const;
+    void _collect();
+    bool _finishPublish(bool wait);
+    void _release(Readback &readback);
+
+    // Publisher thread
+    void _publisherLoop();
+    void _stopPublisher();
+    bool _publish(const uint8_t *pixels, int width, int height, uint64_t timestampNs);
+
+    // GL 1.5 / 3.2 entry points
+    struct GLFunctions;
+    std::unique_ptr<GLFunctions> fGL;
+
+    Readback fReadbacks[kReadbackDepth];
+    uint32_t fNextReadback;         // Also the oldest one
+    uint64_t fFrame;
+
+    std::string fShmName;
+    int fShmFd;
+    size_t fShmSize;
+    FrameCaptureHeader *fHeader;
+
+    FrameCaptureStats fStats;
+
+    // Started with the first frame to publish. Owns fHeader's slots and the mapping
+    // of fPublishing from hand-over until it sets fPublishDone.
+    std::thread fPublisher;
+    std::mutex fPublishMutex;
+    std::condition_variable fPublishCondition;
+    Readback *fPublishing;
+    const uint8_t *fPublishPixels;
+    bool fPublishDone;
+    bool fPublishChanged;
+    uint64_t fPublishNs;
+    bool fQuit;
+};
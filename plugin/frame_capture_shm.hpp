@@ -0,0 +1,113 @@
+/*
+ *  frame_capture_shm.hpp - Shared memory layout of captured editor frames
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * What FrameCapture publishes, for consumer processes (remote display,
+ * recording). Plain C++, include it without GL or GLFW.
+ *
+ * The POSIX shared memory object starts with a FrameCaptureHeader. Frame i
+ * lives in slot i % kFrameCaptureSlots, pixels at slots[n].pixelOffset from
+ * the start of the object: BGRA8, top row first, `stride` bytes per row.
+ *
+ * Frames are only published when something changed. The dirty rectangle of a
+ * frame is relative to the frame before it: a consumer which skipped frames
+ * must take the whole frame.
+ *
+ * Slots are seqlocks. See frame_capture_copy_latest() for how to read one.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+static constexpr uint32_t kFrameCaptureMagic = 0x46434247;   // "GBCF"
+static constexpr uint32_t kFrameCaptureVersion = 1;
+static constexpr uint32_t kFrameCaptureSlots = 3;
+
+// Larger frames are not captured. Memory is only committed as slots get written.
+static constexpr uint32_t kFrameCaptureMaxWidth = 3840;
+static constexpr uint32_t kFrameCaptureMaxHeight = 2160;
+
+struct FrameCaptureSlot {
+    std::atomic<uint64_t> sequence;     // Frame in this slot. 0 while it's being written.
+    uint64_t timestampNs;               // Steady clock, when the frame was rendered
+    uint64_t pixelOffset;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t dirtyX;                    // Changed since frame `sequence - 1`, top-left origin
+    uint32_t dirtyY;
+    uint32_t dirtyWidth;
+    uint32_t dirtyHeight;
+};
+
+struct FrameCaptureHeader {
+    std::atomic<uint32_t> magic;        // kFrameCaptureMagic once the rest of the header is set up
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    std::atomic<uint64_t> latest;       // Newest complete frame, 0 if none yet
+    FrameCaptureSlot slots[kFrameCaptureSlots];
+};
+
+/**
+ * Consumer side: copy the newest frame, `dst` must hold maxWidth * maxHeight * 4
+ * bytes. Returns its sequence, or 0 if the header is not set up yet, there is
+ * no frame yet or the producer kept overwriting it. Fills `meta` with the
+ * slot's fields.
+ */
+inline uint64_t frame_capture_copy_latest(const FrameCaptureHeader *header, uint8_t *dst, FrameCaptureSlot *meta)
+{
+    // Pairs with the producer's release store, after which the header is set up
+    if (header->magic.load(std::memory_order_acquire) != kFrameCaptureMagic)
+        return 0;
+
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        const uint64_t sequence = header->latest.load(std::memory_order_acquire);
+        if (sequence == 0)
+            return 0;
+
+        const FrameCaptureSlot &slot = header->slots[sequence % kFrameCaptureSlots];
+        if (slot.sequence.load(std::memory_order_acquire) != sequence)
+            continue;
+
+        meta->timestampNs = slot.timestampNs;
+        meta->pixelOffset = slot.pixelOffset;
+        meta->width = slot.width;
+        meta->height = slot.height;
+        meta->stride = slot.stride;
+        meta->dirtyX = slot.dirtyX;
+        meta->dirtyY = slot.dirtyY;
+        meta->dirtyWidth = slot.dirtyWidth;
+        meta->dirtyHeight = slot.dirtyHeight;
+
+        std::memcpy(dst, (const uint8_t *)header + meta->pixelOffset, (size_t)meta->stride * meta->height);
+
+        // Still the same frame after copying? Then nothing was torn.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            meta->sequence.store(sequence, std::memory_order_relaxed);
+            return sequence;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ *  frame_pacer.cpp - Low-latency frame pacing for the drawing thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "frame_pacer.hpp"
+#include "monotonic_clock.hpp"
+
+#include <chrono>
+#include <cmath>
+
+// Safety margin between the predicted end of rendering and vblank
+static constexpr double kMarginNs = 1.5e6;
+
+// Render cost is noisy, so plan with some headroom
+static constexpr double kRenderCostHeadroom = 1.25;
+
+FramePacer::FramePacer() :
+    fEnabled(false),
+    fButtonsHeld(0),
+    fNominalPeriodNs(1000000000ull / 60),
+    fInterrupted(false),
+    fFrameActive(false),
+    fFrameStartNs(0),
+    fLastVblankNs(0),
+    fPeriodNs(0.0),
+    fRenderCostNs(0.0)
+{
+}
+
+void FramePacer::setRefreshRate(int hz)
+{
+    if (hz > 0)
+        fNominalPeriodNs.store(1000000000ull / (uint64_t)hz, std::memory_order_relaxed);
+}
+
+bool FramePacer::isActive() const
+{
+    return fEnabled.load(std::memory_order_relaxed) && fButtonsHeld.load(std::memory_order_relaxed) > 0;
+}
+
+void FramePacer::interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(fWaitMutex);
+        fInterrupted = true;
+    }
+    fWaitCondition.notify_all();
+}
+
+void FramePacer::waitForFrameStart()
+{
+    fFrameActive = isActive();
+
+    if (!fFrameActive)
+    {
+        // Phase will be stale once we come back
+        fLastVblankNs = 0;
+        fFrameStartNs = monotonic_now_ns();
+        return;
+    }
+
+    if (fLastVblankNs != 0)
+    {
+        const double period = fPeriodNs > 0.0 ? fPeriodNs : (double)fNominalPeriodNs.load(std::memory_order_relaxed);
+        const uint64_t now = monotonic_now_ns();
+
+        // Next vblank still ahead of us
+        const double elapsed = (double)(now - fLastVblankNs);
+        const double nextVblank = (double)fLastVblankNs + (std::floor(elapsed / period) + 1.0) * period;
+
+        const double startAt = nextVblank - fRenderCostNs * kRenderCostHeadroom - kMarginNs;
+        if (startAt > (double)now)
+        {
+            std::unique_lock<std::mutex> lock(fWaitMutex);
+            fWaitCondition.wait_for(lock, std::chrono::nanoseconds((uint64_t)(startAt - (double)now)),
+                                    [this] { return fInterrupted; });
+        }
+    }
+
+    fFrameStartNs = monotonic_now_ns();
+}
+
+void FramePacer::beforeSwap()
+{
+    if (!fFrameActive)
+        return;
+
+    const double cost = (double)(monotonic_now_ns() - fFrameStartNs);
+
+    // Follow cost increases quickly, decreases slowly, so we rarely miss a vblank
+    const double alpha = cost > fRenderCostNs ? 0.5 : 0.05;
+    fRenderCostNs += (cost - fRenderCostNs) * alpha;
+}
+
+void FramePacer::afterSwap()
+{
+    if (!fFrameActive)
+        return;
+
+    const uint64_t now = monotonic_now_ns();
+
+    if (fLastVblankNs != 0)
+    {
+        // Only intervals close to one refresh period tell us something about the period
+        const double nominal = (double)fNominalPeriodNs.load(std::memory_order_relaxed);
+        const double interval = (double)(now - fLastVblankNs);
+
+        if (interval > nominal * 0.5 && interval < nominal * 1.5)
+            fPeriodNs = fPeriodNs > 0.0 ? fPeriodNs + (interval - fPeriodNs) * 0.1 : interval;
+    }
+
+    fLastVblankNs = now;
+}
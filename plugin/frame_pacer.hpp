@@ -0,0 +1,95 @@
+/*
+ *  frame_pacer.hpp - Low-latency frame pacing for the drawing thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Low-latency interaction mode.
+ *
+ * With vsync on, the usual loop renders a frame as soon as the previous swap is
+ * queued, so input sampled at frame start can be a few frames old by the time
+ * it reaches the screen. When active, the pacer instead:
+ *
+ *   1. Delays frame start until just before the predicted vblank, leaving room
+ *      for the measured render cost. Input arriving meanwhile makes it into
+ *      the frame.
+ *   2. Asks the caller to glFinish() after swapping, so at most one frame is
+ *      ever queued. This also gives us the vblank phase for free, since the
+ *      finish returns when the swap is done.
+ *
+ * The mode is opt-in, and only becomes active while a mouse button is held, so
+ * the extra CPU cost is only paid during interaction.
+ *
+ * Threading: setEnabled() / setRefreshRate() / setButtonsHeld() / interrupt() may
+ * be called from any thread, everything else belongs to the drawing thread.
+ */
+class FramePacer {
+public:
+    FramePacer();
+
+    void setEnabled(bool enabled) { fEnabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return fEnabled.load(std::memory_order_relaxed); }
+
+    // Refresh rate of the monitor, used until we have our own estimate
+    void setRefreshRate(int hz);
+
+    // Number of mouse buttons held right now, as the windowing system sees it.
+    // Send it again on every button, cursor enter/leave and focus change.
+    void setButtonsHeld(int count) { fButtonsHeld.store(count, std::memory_order_relaxed); }
+
+    // Enabled and currently interacting
+    bool isActive() const;
+
+    // Wake up waitForFrameStart(), and make it return right away from now on.
+    // Used when the editor is closing.
+    void interrupt();
+
+    // Drawing thread: sleep until it's time to start the next frame.
+    // Returns immediately when not active.
+    void waitForFrameStart();
+
+    // Drawing thread: call right before glfwSwapBuffers() to measure render cost.
+    void beforeSwap();
+
+    // Drawing thread: call after glfwSwapBuffers() and the optional glFinish().
+    void afterSwap();
+
+    // Pacing state of the current frame, latched by waitForFrameStart().
+    // When true, the caller should glFinish() after swapping.
+    bool isFrameActive() const { return fFrameActive; }
+
+private:
+    std::atomic<bool> fEnabled;
+    std::atomic<int> fButtonsHeld;
+    std::atomic<uint64_t> fNominalPeriodNs;
+
+    // Lets interrupt() cut a frame start wait short
+    std::mutex fWaitMutex;
+    std::condition_variable fWaitCondition;
+    bool fInterrupted;
+
+    // Drawing thread only
+    bool fFrameActive;          // Pacing state latched at frame start
+    uint64_t fFrameStartNs;
+    uint64_t fLastVblankNs;     // Time the last finished swap returned, 0 if unknown
+    double fPeriodNs;           // Estimated vblank period
+    double fRenderCostNs;       // Estimated frame start to swap duration
+};
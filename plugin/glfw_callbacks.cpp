@@ -54,34 +54,45 @@
 /*
  *         ========  Special Notice ========
  * After applying our own callbacks, remember to invoke glfwPollEvents() in MAIN thread!
- * Here I invoke it on GlfwBackendExampleUI::uiIdle().
+ * Here it is invoked by EditorEventPump, from GlfwBackendExampleUI::uiIdle().
  */
 
 #include "PluginUI.hpp"
 #include "backends/imgui_impl_glfw.h"
 
-void GlfwBackendExampleUI::_setMyGLFWCallbacks()
+void EditorSession::_setMyGLFWCallbacks()
 {
     // Define intermediate callback functions.
-    // Those intermediates will execute callbacks defined in GlfwBackendExampleUI's
-    // instance.
+    // Those intermediates will execute callbacks defined in the editor's
+    // EditorSession instance.
+    // A closed window, waiting to be retired or parked in the window pool, has no session. Its events are dropped.
     auto char_callback_func = [](GLFWwindow *w, unsigned int c) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_charCallback(c);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_charCallback(c);
     };
     auto cursor_enter_callback_func = [](GLFWwindow *w, int entered) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_cursorEnterCallback(entered);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_cursorEnterCallback(entered);
     };
     auto mouse_button_callback_func = [](GLFWwindow *w, int button, int action, int mods) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_mouseButtonCallback(button, action, mods);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_mouseButtonCallback(button, action, mods);
     };
     auto scroll_callback_func = [](GLFWwindow *w, double xoffset, double yoffset) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_scrollCallback(xoffset, yoffset);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_scrollCallback(xoffset, yoffset);
     };
     auto key_callback_func = [](GLFWwindow *w, int key, int scancode, int action, int mods) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_keyCallback(key, scancode, action, mods);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_keyCallback(key, scancode, action, mods);
     };
     auto cursor_pos_callback_func = [](GLFWwindow *w, double x, double y) {
-        static_cast<GlfwBackendExampleUI *>(glfwGetWindowUserPointer(w))->_cursorPosCallback(x, y);
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_cursorPosCallback(x, y);
+    };
+    auto window_focus_callback_func = [](GLFWwindow *w, int focused) {
+        if (auto *session = static_cast<EditorSession *>(glfwGetWindowUserPointer(w)))
+            session->_windowFocusCallback(focused);
     };
 
     // Register my own callbacks
@@ -91,6 +102,7 @@ void GlfwBackendExampleUI::_setMyGLFWCallbacks()
     glfwSetScrollCallback(fWindow, scroll_callback_func);
     glfwSetKeyCallback(fWindow, key_callback_func);
     glfwSetCursorPosCallback(fWindow, cursor_pos_callback_func);    // On Linux, this callback is essential
+    glfwSetWindowFocusCallback(fWindow, window_focus_callback_func);
 
     // Set window user pointer to ImguiEditor's current instance
     glfwSetWindowUserPointer(fWindow, this);
@@ -99,40 +111,86 @@ void GlfwBackendExampleUI::_setMyGLFWCallbacks()
 // ---------- CALLBACKS ----------
 // These callbacks will first set correct ImGui context, then invoke ImGui's own
 // callbacks. This can prevent GLFW from accessing wrong ImGui instance.
+//
+// Each event is also timestamped for input-to-swap latency measurement, before it is forwarded.
+// Forwarding happens under the tracker's lock, as the drawing thread's ImGui::NewFrame() drains the same queue.
 
-void GlfwBackendExampleUI::_charCallback(unsigned int c)
+void EditorSession::_charCallback(unsigned int c)
 {
+    TRACE_SCOPE("GLFW char");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency, kInputEventKey);
     ImGui_ImplGlfw_CharCallback(fWindow, c);
 }
 
-void GlfwBackendExampleUI::_cursorEnterCallback(int entered)
+void EditorSession::_cursorEnterCallback(int entered)
 {
+    TRACE_SCOPE("GLFW cursor enter");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency);
     ImGui_ImplGlfw_CursorEnterCallback(fWindow, entered);
+    _syncHeldButtons();
 }
 
-void GlfwBackendExampleUI::_mouseButtonCallback(int button, int action, int mods)
+void EditorSession::_mouseButtonCallback(int button, int action, int mods)
 {
+    TRACE_SCOPE("GLFW mouse button");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency, kInputEventButton);
     ImGui_ImplGlfw_MouseButtonCallback(fWindow, button, action, mods);
+    _syncHeldButtons();
 }
 
-void GlfwBackendExampleUI::_scrollCallback(double xoffset, double yoffset)
+void EditorSession::_scrollCallback(double xoffset, double yoffset)
 {
+    TRACE_SCOPE("GLFW scroll");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency, kInputEventScroll);
     ImGui_ImplGlfw_ScrollCallback(fWindow, xoffset, yoffset);
 }
 
-void GlfwBackendExampleUI::_keyCallback(int key, int scancode, int action, int mods)
+void EditorSession::_keyCallback(int key, int scancode, int action, int mods)
 {
+    TRACE_SCOPE("GLFW key");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency, kInputEventKey);
     ImGui_ImplGlfw_KeyCallback(fWindow, key, scancode, action, mods);
 }
 
 // On Linux, this callback is essential
-void GlfwBackendExampleUI::_cursorPosCallback(double x, double y)
+void EditorSession::_cursorPosCallback(double x, double y)
 {
+    TRACE_SCOPE("GLFW cursor pos");
     ImGui::SetCurrentContext(this->fMyImGuiContext);
+    const InputLatencyTracker::EventScope event(fInputLatency, kInputEventMotion);
     ImGui_ImplGlfw_CursorPosCallback(fWindow, x, y);
 }
+
+void EditorSession::_windowFocusCallback(int focused)
+{
+    TRACE_SCOPE("GLFW window focus");
+    ImGui::SetCurrentContext(this->fMyImGuiContext);
+    ImGui_ImplGlfw_WindowFocusCallback(fWindow, focused);
+
+    // A release while unfocused never reaches us. GLFW also treats losing focus as releasing everything.
+    if (focused)
+        _syncHeldButtons();
+    else
+        fFramePacer.setButtonsHeld(0);
+}
+
+/**
+ * Count held buttons from GLFW's state instead of counting presses and releases:
+ * one lost release would otherwise keep low-latency mode active for good.
+ */
+void EditorSession::_syncHeldButtons()
+{
+    int held = 0;
+    for (int button = GLFW_MOUSE_BUTTON_1; button <= GLFW_MOUSE_BUTTON_LAST; ++button)
+    {
+        if (glfwGetMouseButton(fWindow, button) == GLFW_PRESS)
+            ++held;
+    }
+
+    fFramePacer.setButtonsHeld(held);
+}
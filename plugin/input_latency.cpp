@@ -0,0 +1,224 @@
+/*
+ *  input_latency.cpp - Input-to-swap latency measurement
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "input_latency.hpp"
+#include "monotonic_clock.hpp"
+
+#include <imgui.h>
+#include <imgui_internal.h>
+
+static const char *const kInputEventTypeNames[kInputEventTypeCount] = {
+    "Motion", "Button", "Key", "Scroll"
+};
+
+double InputLatencyStats::percentileMs(double p) const
+{
+    if (count == 0)
+        return 0.0;
+
+    const uint64_t target = (uint64_t)(p * (double)count + 0.5);
+    uint64_t accumulated = 0;
+
+    for (uint32_t i = 0; i < kBucketCount; ++i)
+    {
+        accumulated += buckets[i];
+        if (accumulated >= target)
+            return (double)(i + 1);
+    }
+
+    return maxMs;
+}
+
+InputLatencyTracker::InputLatencyTracker() :
+    fQueueRemoved(0),
+    fPendingHead(0),
+    fPendingCount(0),
+    fConsumedCount(0),
+    fOverflow(0)
+{
+    reset();
+}
+
+// Stamp first: whatever happens from here on is part of the latency
+InputLatencyTracker::EventScope::EventScope(InputLatencyTracker &tracker, InputEventType type) :
+    fTracker(tracker),
+    fType(type),
+    fStampNs(monotonic_now_ns()),
+    fLock(tracker.fInputMutex)
+{
+}
+
+InputLatencyTracker::EventScope::EventScope(InputLatencyTracker &tracker) :
+    fTracker(tracker),
+    fType(kInputEventTypeCount),
+    fStampNs(0),
+    fLock(tracker.fInputMutex)
+{
+}
+
+InputLatencyTracker::EventScope::~EventScope()
+{
+    if (fType == kInputEventTypeCount)
+        return;
+
+    if (fTracker.fPendingCount == kMaxPendingEvents)
+    {
+        fTracker.fOverflow.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // The event was forwarded, so its entries are the last ones queued. Duplicates ImGui filtered out add none.
+    PendingEvent &event = fTracker.fPending[(fTracker.fPendingHead + fTracker.fPendingCount) % kMaxPendingEvents];
+    event.stampNs = fStampNs;
+    event.queueEnd = fTracker.fQueueRemoved + (uint64_t)GImGui->InputEventsQueue.Size;
+    event.type = fType;
+
+    ++fTracker.fPendingCount;
+}
+
+void InputLatencyTracker::newFrame()
+{
+    const int queuedBefore = GImGui->InputEventsQueue.Size;
+    ImGui::NewFrame();
+
+    // NewFrame() processes events from the front of the queue, nothing else touches it under the lock
+    const int queuedAfter = GImGui->InputEventsQueue.Size;
+    if (queuedAfter < queuedBefore)
+        fQueueRemoved += (uint64_t)(queuedBefore - queuedAfter);
+
+    while (fPendingCount > 0)
+    {
+        const PendingEvent &event = fPending[fPendingHead];
+        if (event.queueEnd > fQueueRemoved)
+            break;
+
+        // A frame which was never swapped hands its events on to this one
+        if (fConsumedCount < kMaxPendingEvents)
+            fConsumed[fConsumedCount++] = event;
+        else
+            fOverflow.fetch_add(1, std::memory_order_relaxed);
+
+        fPendingHead = (fPendingHead + 1) % kMaxPendingEvents;
+        --fPendingCount;
+    }
+}
+
+void InputLatencyTracker::frameSwapped()
+{
+    const uint64_t swapTime = monotonic_now_ns();
+
+    for (uint32_t i = 0; i < fConsumedCount; ++i)
+    {
+        const PendingEvent &event = fConsumed[i];
+        _record(event.type, swapTime > event.stampNs ? swapTime - event.stampNs : 0);
+    }
+
+    fConsumedCount = 0;
+}
+
+void InputLatencyTracker::_record(InputEventType type, uint64_t latencyNs)
+{
+    Histogram &h = fHistograms[type];
+
+    uint64_t bucket = latencyNs / 1000000;
+    if (bucket >= InputLatencyStats::kBucketCount)
+        bucket = InputLatencyStats::kBucketCount - 1;
+
+    h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    h.sumNs.fetch_add(latencyNs, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+
+    // Only the drawing thread records, so a plain compare-and-store is enough
+    if (latencyNs > h.maxNs.load(std::memory_order_relaxed))
+        h.maxNs.store(latencyNs, std::memory_order_relaxed);
+}
+
+InputLatencyStats InputLatencyTracker::getStats(InputEventType type) const
+{
+    const Histogram &h = fHistograms[type];
+    InputLatencyStats stats;
+
+    // Counters are read independently, so the snapshot may be off by a sample or so.
+    for (uint32_t i = 0; i < InputLatencyStats::kBucketCount; ++i)
+        stats.buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+
+    stats.count = h.count.load(std::memory_order_relaxed);
+    stats.maxMs = (double)h.maxNs.load(std::memory_order_relaxed) / 1e6;
+    if (stats.count > 0)
+        stats.meanMs = (double)h.sumNs.load(std::memory_order_relaxed) / 1e6 / (double)stats.count;
+
+    return stats;
+}
+
+void InputLatencyTracker::reset()
+{
+    fOverflow.store(0, std::memory_order_relaxed);
+
+    for (uint32_t t = 0; t < kInputEventTypeCount; ++t)
+    {
+        Histogram &h = fHistograms[t];
+
+        h.count.store(0, std::memory_order_relaxed);
+        h.sumNs.store(0, std::memory_order_relaxed);
+        h.maxNs.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < InputLatencyStats::kBucketCount; ++i)
+            h.buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void InputLatencyTracker::drawOverlay() const
+{
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                   ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+
+    if (ImGui::Begin("Input latency", nullptr, flags))
+    {
+        ImGui::TextUnformatted("Input-to-swap latency (ms)");
+        ImGui::Separator();
+
+        if (ImGui::BeginTable("##latency", 5))
+        {
+            ImGui::TableSetupColumn("Event");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Mean");
+            ImGui::TableSetupColumn("P95");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+
+            for (uint32_t t = 0; t < kInputEventTypeCount; ++t)
+            {
+                const InputLatencyStats stats = getStats((InputEventType)t);
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(kInputEventTypeNames[t]);
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.count);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", stats.meanMs);
+                ImGui::TableNextColumn(); ImGui::Text("%.0f", stats.percentileMs(0.95));
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", stats.maxMs);
+            }
+
+            ImGui::EndTable();
+        }
+
+        const uint64_t overflow = getOverflowCount();
+        if (overflow > 0)
+            ImGui::Text("%llu events not measured", (unsigned long long)overflow);
+    }
+    ImGui::End();
+}
@@ -0,0 +1,146 @@
+/*
+ *  input_latency.hpp - Input-to-swap latency measurement
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Kinds of input events we measure separately.
+ * Char events are counted as key events.
+ */
+enum InputEventType {
+    kInputEventMotion = 0,
+    kInputEventButton,
+    kInputEventKey,
+    kInputEventScroll,
+    kInputEventTypeCount
+};
+
+/**
+ * Snapshot of one latency histogram.
+ * Bucket i counts samples within [i, i+1) milliseconds, the last bucket also
+ * takes everything above.
+ */
+struct InputLatencyStats {
+    static constexpr uint32_t kBucketCount = 64;
+
+    uint64_t count = 0;
+    double meanMs = 0.0;
+    double maxMs = 0.0;
+    uint64_t buckets[kBucketCount] = {};
+
+    // Upper bound (in ms) of the bucket containing the given percentile (0..1).
+    double percentileMs(double p) const;
+};
+
+/**
+ * Tracks the time from an input event arriving in our GLFW callbacks until the
+ * glfwSwapBuffers() call of the frame whose ImGui::NewFrame() consumed it.
+ *
+ * Every event is stamped before it is forwarded to ImGui, and remembers where
+ * its ImGui input events ended up in ImGui's input queue. NewFrame() may leave
+ * events queued for later frames (io.ConfigInputTrickleEventQueue), so an event
+ * only counts as consumed once the queue has been drained past it. Each event
+ * is one sample.
+ *
+ * Forwarding events and NewFrame() both touch ImGui's input queue, from
+ * different threads. They are serialised by the tracker's lock.
+ *
+ * Threading:
+ *   - EventScope is used by the GLFW callbacks on the main thread.
+ *   - lockInput() / newFrame() / frameSwapped() are called by the drawing thread.
+ *   - getStats() / reset() may be called from anywhere.
+ */
+class InputLatencyTracker {
+public:
+    // Events waiting for a frame, and events consumed by the frame being drawn
+    static constexpr uint32_t kMaxPendingEvents = 256;
+
+    InputLatencyTracker();
+
+    /**
+     * Main thread: wrap forwarding one GLFW event to ImGui, with the editor's ImGui context current.
+     * Without a type, the event is forwarded under the lock but not measured.
+     */
+    class EventScope {
+    public:
+        EventScope(InputLatencyTracker &tracker, InputEventType type);
+        explicit EventScope(InputLatencyTracker &tracker);
+        ~EventScope();
+
+    private:
+        InputLatencyTracker &fTracker;
+        InputEventType fType;
+        uint64_t fStampNs;                  // Taken before waiting for the lock
+        std::lock_guard<std::mutex> fLock;
+    };
+
+    // Drawing thread: hold this from ImGui_ImplGlfw_NewFrame() until newFrame() has returned
+    std::unique_lock<std::mutex> lockInput() { return std::unique_lock<std::mutex>(fInputMutex); }
+
+    // Drawing thread, under lockInput(): call ImGui::NewFrame() and take the events it consumed
+    void newFrame();
+
+    // Call right after glfwSwapBuffers().
+    void frameSwapped();
+
+    InputLatencyStats getStats(InputEventType type) const;
+    void reset();
+
+    // Events which could not be tracked because too many were pending
+    uint64_t getOverflowCount() const { return fOverflow.load(std::memory_order_relaxed); }
+
+    // Draw a small ImGui window with the current statistics.
+    // Must be called between ImGui::NewFrame() and ImGui::Render().
+    void drawOverlay() const;
+
+private:
+    struct Histogram {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sumNs;
+        std::atomic<uint64_t> maxNs;
+        std::atomic<uint64_t> buckets[InputLatencyStats::kBucketCount];
+    };
+
+    struct PendingEvent {
+        uint64_t stampNs;
+        uint64_t queueEnd;          // Position in ImGui's input queue right after this event's own entries
+        InputEventType type;
+    };
+
+    void _record(InputEventType type, uint64_t latencyNs);
+
+    // Guards ImGui's input queue, and everything below up to fConsumed
+    std::mutex fInputMutex;
+
+    // Positions count every entry ever queued in ImGui: entries removed by NewFrame() so far, plus the index
+    uint64_t fQueueRemoved;
+
+    // FIFO of stamped events not consumed yet
+    PendingEvent fPending[kMaxPendingEvents];
+    uint32_t fPendingHead;
+    uint32_t fPendingCount;
+
+    // Drawing thread only: events consumed by the current frame
+    PendingEvent fConsumed[kMaxPendingEvents];
+    uint32_t fConsumedCount;
+
+    std::atomic<uint64_t> fOverflow;
+    Histogram fHistograms[kInputEventTypeCount];
+};
@@ -0,0 +1,33 @@
+/*
+ *  monotonic_clock.hpp - Timestamps shared by all measurements
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Steady clock in nanoseconds. Never zero, so zero can mean "no timestamp".
+ * One clock for all threads and modules, so their timestamps can be compared.
+ */
+inline uint64_t monotonic_now_ns()
+{
+    const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // The epoch is unspecified, it may be boot time
+    return ns != 0 ? ns : 1;
+}
@@ -0,0 +1,92 @@
+/*
+ *  parameter_store.cpp - Lock-free parameter values with per-consumer change tracking
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "parameter_store.hpp"
+
+#include <new>
+
+static uint32_t div_round_up(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+ParameterStore::ParameterStore(uint32_t count) :
+    fCount(count),
+    fDirtyWords(div_round_up(count, 64)),
+    fSummaryWords(div_round_up(fDirtyWords, 64)),
+    fBitLinesPerConsumer(div_round_up(fDirtyWords, 8)),
+    fSummaryLinesPerConsumer(div_round_up(fSummaryWords, 8))
+{
+    const size_t valueLines = div_round_up(count, 16);
+    const size_t dirtyLines = (size_t)fBitLinesPerConsumer * kParameterConsumerCount;
+    const size_t summaryLines = (size_t)fSummaryLinesPerConsumer * kParameterConsumerCount;
+
+    // One spare line to align the start
+    fStorage.reset(new uint8_t[(valueLines + dirtyLines + summaryLines + 1) * 64]);
+    uint8_t *line = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(fStorage.get()) + 63) & ~(uintptr_t)63);
+
+    fValues = reinterpret_cast<ValueLine *>(line);
+    fDirty = reinterpret_cast<BitLine *>(line + valueLines * 64);
+    fSummary = reinterpret_cast<BitLine *>(line + (valueLines + dirtyLines) * 64);
+
+    // Atomics are trivially destructible, so the lines are never destroyed, only freed with the block
+    for (size_t i = 0; i < valueLines; ++i)
+        new (&fValues[i]) ValueLine;
+    for (size_t i = 0; i < dirtyLines; ++i)
+        new (&fDirty[i]) BitLine;
+    for (size_t i = 0; i < summaryLines; ++i)
+        new (&fSummary[i]) BitLine;
+
+    for (uint32_t i = 0; i < div_round_up(count, 16) * 16; ++i)
+        fValues[i / 16].values[i % 16].store(0.0f, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < fBitLinesPerConsumer * kParameterConsumerCount * 8; ++i)
+        fDirty[i / 8].words[i % 8].store(0, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < fSummaryLinesPerConsumer * kParameterConsumerCount * 8; ++i)
+        fSummary[i / 8].words[i % 8].store(0, std::memory_order_relaxed);
+}
+
+void ParameterStore::set(uint32_t index, float value)
+{
+    if (index >= fCount)
+        return;
+
+    const float previous = fValues[index / 16].values[index % 16].exchange(value, std::memory_order_relaxed);
+    if (previous == value)
+        return;
+
+    // Dirty bit first, then summary bit: a consumer which sees the summary bit also finds the dirty bit
+    const uint32_t word = index / 64;
+    const uint64_t bit = (uint64_t)1 << (index % 64);
+    const uint64_t summaryBit = (uint64_t)1 << (word % 64);
+
+    for (uint32_t c = 0; c < kParameterConsumerCount; ++c)
+    {
+        const ParameterConsumer consumer = (ParameterConsumer)c;
+
+        _dirtyWord(consumer, word).fetch_or(bit, std::memory_order_release);
+        _summaryWord(consumer, word / 64).fetch_or(summaryBit, std::memory_order_release);
+    }
+}
+
+float ParameterStore::get(uint32_t index) const
+{
+    if (index >= fCount)
+        return 0.0f;
+
+    return fValues[index / 16].values[index % 16].load(std::memory_order_relaxed);
+}
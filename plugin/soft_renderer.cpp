@@ -0,0 +1,847 @@
+/*
+ *  soft_renderer.cpp - CPU renderer for ImGui draw data, presented via MIT-SHM
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "soft_renderer.hpp"
+
+#include "DistrhoUtils.hpp"
+
+#include <GLFW/glfw3native.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Tile size. Wide, as spans are rasterised row by row. Small enough to balance work between threads,
+// big enough that most of ImGui's triangles (glyphs, frame borders) land in a single tile.
+static constexpr int kTileWidth = 128;
+static constexpr int kTileHeight = 32;
+
+// Upper limit of worker threads. Beyond this, binning on the calling thread starts to dominate.
+static constexpr unsigned kMaxThreads = 4;
+
+// ------------------------------------------------------------------------------------------------------------
+// Pixel helpers
+
+// Exact (v + 127) / 255 for v in [0, 65025]
+static inline uint32_t div255(uint32_t v)
+{
+    v += 128;
+    return (v + (v >> 8)) >> 8;
+}
+
+static inline uint32_t blend_pixel(uint32_t dst, uint32_t src, uint32_t alpha)
+{
+    const uint32_t inv = 255 - alpha;
+    uint32_t out = 0xff000000;
+
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+    {
+        const uint32_t d = (dst >> shift) & 0xff;
+        const uint32_t s = (src >> shift) & 0xff;
+        out |= div255(s * alpha + d * inv) << shift;
+    }
+
+    return out;
+}
+
+/**
+ * Flat colour span: every pixel gets the same source colour and alpha.
+ * This covers the bulk of ImGui's geometry (window backgrounds, frames, lines).
+ */
+static void blend_span_solid(uint32_t *dst, int count, uint32_t src, uint32_t alpha)
+{
+    if (alpha >= 255)
+    {
+        std::fill(dst, dst + count, src | 0xff000000);
+        return;
+    }
+
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero);
+    const __m128i srcAlpha = _mm_mullo_epi16(src16, _mm_set1_epi16((short)alpha));
+    const __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i opaque = _mm_set1_epi32((int)0xff000000);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, inv), srcAlpha), bias);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, inv), srcAlpha), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = blend_pixel(dst[i], src, alpha);
+}
+
+/**
+ * Constant colour with per-pixel coverage, i.e. glyphs sampled from the font atlas.
+ */
+static void blend_span_coverage(uint32_t *dst, int count, uint32_t src, const uint8_t *alpha)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero);
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i opaque = _mm_set1_epi32((int)0xff000000);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        // Fully transparent runs are common between glyphs
+        if ((alpha[i] | alpha[i + 1] | alpha[i + 2] | alpha[i + 3]) == 0)
+            continue;
+
+        const __m128i aLo = _mm_set_epi16(alpha[i + 1], alpha[i + 1], alpha[i + 1], alpha[i + 1],
+                                          alpha[i], alpha[i], alpha[i], alpha[i]);
+        const __m128i aHi = _mm_set_epi16(alpha[i + 3], alpha[i + 3], alpha[i + 3], alpha[i + 3],
+                                          alpha[i + 2], alpha[i + 2], alpha[i + 2], alpha[i + 2]);
+
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, _mm_sub_epi16(full, aLo)), _mm_mullo_epi16(src16, aLo)), bias);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, _mm_sub_epi16(full, aHi)), _mm_mullo_epi16(src16, aHi)), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        if (alpha[i] != 0)
+            dst[i] = blend_pixel(dst[i], src, alpha[i]);
+    }
+}
+
+static inline const uint8_t *sample_texel(const SoftTexture *tex, float u, float v)
+{
+    int x = (int)(u * (float)tex->width);
+    int y = (int)(v * (float)tex->height);
+    x = std::min(std::max(x, 0), tex->width - 1);
+    y = std::min(std::max(y, 0), tex->height - 1);
+
+    return tex->pixels + ((size_t)y * (size_t)tex->width + (size_t)x) * 4;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// SoftRasterizer
+
+SoftRasterizer::SoftRasterizer(unsigned threadCount) :
+    fBgra(true),
+    fDrawData(nullptr),
+    fPixels(nullptr),
+    fWidth(0), fHeight(0), fStride(0),
+    fClearPixel(0),
+    fClipOffset(0.0f, 0.0f),
+    fClipScale(1.0f, 1.0f),
+    fTilesX(0), fTilesY(0),
+    fNextTile(0),
+    fThreadCount(threadCount),
+    fJobSerial(0),
+    fBusyWorkers(0),
+    fQuit(false)
+{
+    if (fThreadCount == 0)
+    {
+        const unsigned hw = std::thread::hardware_concurrency();
+        fThreadCount = hw > 1 ? std::min(hw, kMaxThreads) : 1;
+    }
+}
+
+SoftRasterizer::~SoftRasterizer()
+{
+    stopWorkers();
+}
+
+void SoftRasterizer::startWorkers()
+{
+    if (!fWorkers.empty())
+        return;
+
+    fQuit = false;
+
+    // The rendering thread does its share too, so spawn one less.
+    // New workers start from the current job serial, or they'd take the last job for a new one.
+    for (unsigned i = 1; i < fThreadCount; ++i)
+        fWorkers.emplace_back(&SoftRasterizer::_workerLoop, this, fJobSerial);
+}
+
+void SoftRasterizer::stopWorkers()
+{
+    if (fWorkers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+    fStartCondition.notify_all();
+
+    for (std::thread &worker : fWorkers)
+        worker.join();
+    fWorkers.clear();
+}
+
+uint32_t SoftRasterizer::_packColor(uint32_t r, uint32_t g, uint32_t b) const
+{
+    return fBgra ? (0xff000000 | (r << 16) | (g << 8) | b)
+                 : (0xff000000 | (b << 16) | (g << 8) | r);
+}
+
+void SoftRasterizer::render(const ImDrawData *drawData, uint32_t *pixels, int width, int height, int stride, const ImVec4 &clearColor)
+{
+    fDrawData = drawData;
+    fPixels = pixels;
+    fWidth = width;
+    fHeight = height;
+    fStride = stride;
+    fClearPixel = _packColor((uint32_t)(clearColor.x * clearColor.w * 255.0f + 0.5f),
+                             (uint32_t)(clearColor.y * clearColor.w * 255.0f + 0.5f),
+                             (uint32_t)(clearColor.z * clearColor.w * 255.0f + 0.5f));
+
+    if (drawData != nullptr)
+    {
+        fClipOffset = drawData->DisplayPos;
+        fClipScale = drawData->FramebufferScale;
+    }
+
+    fTilesX = (width + kTileWidth - 1) / kTileWidth;
+    fTilesY = (height + kTileHeight - 1) / kTileHeight;
+    _binTriangles();
+
+    fNextTile.store(0, std::memory_order_relaxed);
+
+    if (!fWorkers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fBusyWorkers = (unsigned)fWorkers.size();
+            ++fJobSerial;
+        }
+        fStartCondition.notify_all();
+    }
+
+    _runTiles();
+
+    if (!fWorkers.empty())
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fDoneCondition.wait(lock, [this] { return fBusyWorkers == 0; });
+    }
+}
+
+void SoftRasterizer::_workerLoop(uint64_t lastSerial)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fStartCondition.wait(lock, [&] { return fQuit || fJobSerial != lastSerial; });
+            if (fQuit)
+                return;
+            lastSerial = fJobSerial;
+        }
+
+        _runTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            if (--fBusyWorkers == 0)
+                fDoneCondition.notify_one();
+        }
+    }
+}
+
+/**
+ * Calling thread, before any worker starts: sort triangles into the tiles they
+ * may touch. Setup that only depends on the command (clip rect, texture) is
+ * done here once, instead of once per tile.
+ */
+void SoftRasterizer::_binTriangles()
+{
+    const size_t tileCount = (size_t)fTilesX * (size_t)fTilesY;
+    if (fTileBins.size() < tileCount)
+        fTileBins.resize(tileCount);
+    for (size_t i = 0; i < tileCount; ++i)
+        fTileBins[i].clear();
+    fCommands.clear();
+
+    if (fDrawData == nullptr)
+        return;
+
+    for (int n = 0; n < fDrawData->CmdListsCount; ++n)
+    {
+        const ImDrawList *drawList = fDrawData->CmdLists[n];
+
+        for (const ImDrawCmd &cmd : drawList->CmdBuffer)
+        {
+            // User callbacks are GL code, and there's no render state to reset here
+            if (cmd.UserCallback != nullptr)
+                continue;
+
+            // Same truncation as the GL2 backend's scissor
+            BinnedCommand command;
+            command.clip[0] = std::max(0, (int)((cmd.ClipRect.x - fClipOffset.x) * fClipScale.x));
+            command.clip[1] = std::max(0, (int)((cmd.ClipRect.y - fClipOffset.y) * fClipScale.y));
+            command.clip[2] = std::min(fWidth, (int)((cmd.ClipRect.z - fClipOffset.x) * fClipScale.x));
+            command.clip[3] = std::min(fHeight, (int)((cmd.ClipRect.w - fClipOffset.y) * fClipScale.y));
+            command.tex = (const SoftTexture *)cmd.GetTexID();
+
+            if (command.clip[2] <= command.clip[0] || command.clip[3] <= command.clip[1])
+                continue;
+
+            const uint32_t commandIndex = (uint32_t)fCommands.size();
+            fCommands.push_back(command);
+
+            const ImDrawVert *vtx = drawList->VtxBuffer.Data + cmd.VtxOffset;
+            const ImDrawIdx *idx = drawList->IdxBuffer.Data + cmd.IdxOffset;
+
+            for (unsigned int i = 0; i + 2 < cmd.ElemCount; i += 3)
+            {
+                const BinnedTriangle triangle = { { &vtx[idx[i]], &vtx[idx[i + 1]], &vtx[idx[i + 2]] }, commandIndex };
+
+                // Same bounds as _drawTriangle() rasterises, so no tile misses a pixel
+                float minX = triangle.v[0]->pos.x, maxX = minX;
+                float minY = triangle.v[0]->pos.y, maxY = minY;
+                for (int k = 1; k < 3; ++k)
+                {
+                    minX = std::min(minX, triangle.v[k]->pos.x);
+                    maxX = std::max(maxX, triangle.v[k]->pos.x);
+                    minY = std::min(minY, triangle.v[k]->pos.y);
+                    maxY = std::max(maxY, triangle.v[k]->pos.y);
+                }
+
+                const int x0 = std::max(command.clip[0], (int)std::floor((minX - fClipOffset.x) * fClipScale.x));
+                const int x1 = std::min(command.clip[2], (int)std::ceil((maxX - fClipOffset.x) * fClipScale.x));
+                const int y0 = std::max(command.clip[1], (int)std::floor((minY - fClipOffset.y) * fClipScale.y));
+                const int y1 = std::min(command.clip[3], (int)std::ceil((maxY - fClipOffset.y) * fClipScale.y));
+                if (x0 >= x1 || y0 >= y1)
+                    continue;
+
+                for (int ty = y0 / kTileHeight; ty <= (y1 - 1) / kTileHeight; ++ty)
+                {
+                    for (int tx = x0 / kTileWidth; tx <= (x1 - 1) / kTileWidth; ++tx)
+                        fTileBins[(size_t)ty * fTilesX + tx].push_back(triangle);
+                }
+            }
+        }
+    }
+}
+
+void SoftRasterizer::_runTiles()
+{
+    const int tileCount = fTilesX * fTilesY;
+
+    for (;;)
+    {
+        const int tile = fNextTile.fetch_add(1, std::memory_order_relaxed);
+        if (tile >= tileCount)
+            break;
+
+        _renderTile(tile);
+    }
+}
+
+void SoftRasterizer::_renderTile(int tile)
+{
+    const int x0 = (tile % fTilesX) * kTileWidth;
+    const int y0 = (tile / fTilesX) * kTileHeight;
+    const int x1 = std::min(x0 + kTileWidth, fWidth);
+    const int y1 = std::min(y0 + kTileHeight, fHeight);
+
+    for (int y = y0; y < y1; ++y)
+        std::fill(fPixels + (size_t)y * fStride + x0, fPixels + (size_t)y * fStride + x1, fClearPixel);
+
+    for (const BinnedTriangle &triangle : fTileBins[(size_t)tile])
+    {
+        const BinnedCommand &command = fCommands[triangle.command];
+        const int clip[4] = {
+            std::max(x0, command.clip[0]),
+            std::max(y0, command.clip[1]),
+            std::min(x1, command.clip[2]),
+            std::min(y1, command.clip[3]),
+        };
+
+        if (clip[2] > clip[0] && clip[3] > clip[1])
+            _drawTriangle(*triangle.v[0], *triangle.v[1], *triangle.v[2], clip, command.tex);
+    }
+}
+
+void SoftRasterizer::_drawTriangle(const ImDrawVert &va, const ImDrawVert &vb, const ImDrawVert &vc,
+                                   const int clip[4], const SoftTexture *tex)
+{
+    const ImDrawVert *v[3] = { &va, &vb, &vc };
+    float px[3], py[3];
+
+    for (int i = 0; i < 3; ++i)
+    {
+        px[i] = (v[i]->pos.x - fClipOffset.x) * fClipScale.x;
+        py[i] = (v[i]->pos.y - fClipOffset.y) * fClipScale.y;
+    }
+
+    // Cheap rejection first: a triangle binned to several tiles only covers part of each
+    const int minY = std::max(clip[1], (int)std::floor(std::min(py[0], std::min(py[1], py[2]))));
+    const int maxY = std::min(clip[3], (int)std::ceil(std::max(py[0], std::max(py[1], py[2]))));
+    if (minY >= maxY)
+        return;
+
+    const int minX = std::max(clip[0], (int)std::floor(std::min(px[0], std::min(px[1], px[2]))));
+    const int maxX = std::min(clip[2], (int)std::ceil(std::max(px[0], std::max(px[1], px[2]))));
+    if (minX >= maxX)
+        return;
+
+    // ImGui emits both windings. Normalise to positive area.
+    float area = (px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]);
+    if (area < 0.0f)
+    {
+        std::swap(v[1], v[2]);
+        std::swap(px[1], px[2]);
+        std::swap(py[1], py[2]);
+        area = -area;
+    }
+    if (area < 1e-6f)
+        return;
+
+    /**
+     * Edge i is opposite of vertex i: E_i(x, y) = A_i * x + B_i * y + C_i.
+     * Inside means all E_i >= 0, and E_i / area is the barycentric weight of vertex i.
+     *
+     * Pixels exactly on an edge shared by two triangles go to only one of them
+     * (edges with A > 0, or horizontal edges with B > 0), so translucent quads
+     * do not get their diagonal blended twice.
+     */
+    float edgeA[3], edgeB[3], edgeC[3];
+    bool edgeInclusive[3];
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const int a = (i + 1) % 3, b = (i + 2) % 3;
+
+        edgeA[i] = -(py[b] - py[a]);
+        edgeB[i] = px[b] - px[a];
+        edgeC[i] = -(edgeA[i] * px[a] + edgeB[i] * py[a]);
+        edgeInclusive[i] = edgeA[i] > 0.0f || (edgeA[i] == 0.0f && edgeB[i] > 0.0f);
+    }
+
+    const uint32_t col = v[0]->col;
+    const bool sameColor = v[1]->col == col && v[2]->col == col;
+    const bool sameUv = v[0]->uv.x == v[1]->uv.x && v[0]->uv.x == v[2]->uv.x &&
+                        v[0]->uv.y == v[1]->uv.y && v[0]->uv.y == v[2]->uv.y;
+
+    const uint32_t colR = (col >> IM_COL32_R_SHIFT) & 0xff;
+    const uint32_t colG = (col >> IM_COL32_G_SHIFT) & 0xff;
+    const uint32_t colB = (col >> IM_COL32_B_SHIFT) & 0xff;
+    const uint32_t colA = (col >> IM_COL32_A_SHIFT) & 0xff;
+
+    enum { kFlat, kCoverage, kGeneric } mode = kGeneric;
+    uint32_t flatPixel = 0, flatAlpha = 0;
+
+    if (sameColor && (sameUv || tex == nullptr))
+    {
+        // Flat colour. Most of the time UV is the atlas' white pixel.
+        uint32_t texR = 255, texG = 255, texB = 255, texA = 255;
+        if (tex != nullptr)
+        {
+            const uint8_t *texel = sample_texel(tex, v[0]->uv.x, v[0]->uv.y);
+            texR = texel[0]; texG = texel[1]; texB = texel[2]; texA = texel[3];
+        }
+
+        flatAlpha = div255(colA * texA);
+        if (flatAlpha == 0)
+            return;
+
+        flatPixel = _packColor(div255(colR * texR), div255(colG * texG), div255(colB * texB));
+        mode = kFlat;
+    }
+    else if (sameColor && tex->whiteRgb)
+    {
+        // Constant colour modulated by texture alpha only, i.e. text
+        if (colA == 0)
+            return;
+
+        flatPixel = _packColor(colR, colG, colB);
+        mode = kCoverage;
+    }
+
+    // Attribute gradients for the non-flat paths: u, v, r, g, b, a
+    float attr[3][6];
+    float attrStep[6] = {};
+
+    if (mode != kFlat)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            attr[i][0] = v[i]->uv.x;
+            attr[i][1] = v[i]->uv.y;
+            attr[i][2] = (float)((v[i]->col >> IM_COL32_R_SHIFT) & 0xff);
+            attr[i][3] = (float)((v[i]->col >> IM_COL32_G_SHIFT) & 0xff);
+            attr[i][4] = (float)((v[i]->col >> IM_COL32_B_SHIFT) & 0xff);
+            attr[i][5] = (float)((v[i]->col >> IM_COL32_A_SHIFT) & 0xff);
+        }
+
+        for (int k = 0; k < 6; ++k)
+            attrStep[k] = (edgeA[0] * attr[0][k] + edgeA[1] * attr[1][k] + edgeA[2] * attr[2][k]) / area;
+    }
+
+    uint8_t coverage[256];
+
+    for (int y = minY; y < maxY; ++y)
+    {
+        const float centerY = (float)y + 0.5f;
+        int spanBegin = minX, spanEnd = maxX;
+        float rowC[3];
+
+        for (int i = 0; i < 3 && spanBegin < spanEnd; ++i)
+        {
+            rowC[i] = edgeB[i] * centerY + edgeC[i];
+
+            if (edgeA[i] == 0.0f)
+            {
+                if (rowC[i] < 0.0f || (rowC[i] == 0.0f && !edgeInclusive[i]))
+                    spanEnd = spanBegin;
+                continue;
+            }
+
+            // E_i(x + 0.5) == 0 at x == t. Clamp before converting, t can be huge for near-horizontal edges.
+            float t = -rowC[i] / edgeA[i] - 0.5f;
+            t = std::min(std::max(t, (float)minX - 2.0f), (float)maxX + 2.0f);
+
+            if (edgeA[i] > 0.0f)
+                spanBegin = std::max(spanBegin, edgeInclusive[i] ? (int)std::ceil(t) : (int)std::floor(t) + 1);
+            else
+                spanEnd = std::min(spanEnd, edgeInclusive[i] ? (int)std::floor(t) + 1 : (int)std::ceil(t));
+        }
+
+        if (spanBegin >= spanEnd)
+            continue;
+
+        uint32_t *row = fPixels + (size_t)y * fStride;
+
+        if (mode == kFlat)
+        {
+            blend_span_solid(row + spanBegin, spanEnd - spanBegin, flatPixel, flatAlpha);
+            continue;
+        }
+
+        // Attributes at the first pixel center of this span
+        float value[6];
+        const float startX = (float)spanBegin + 0.5f;
+        for (int k = 0; k < 6; ++k)
+        {
+            value[k] = 0.0f;
+            for (int i = 0; i < 3; ++i)
+                value[k] += (edgeA[i] * startX + rowC[i]) / area * attr[i][k];
+        }
+
+        if (mode == kCoverage)
+        {
+            for (int x = spanBegin; x < spanEnd; )
+            {
+                const int count = std::min(spanEnd - x, (int)sizeof(coverage));
+
+                for (int j = 0; j < count; ++j)
+                {
+                    coverage[j] = (uint8_t)div255(colA * sample_texel(tex, value[0], value[1])[3]);
+                    value[0] += attrStep[0];
+                    value[1] += attrStep[1];
+                }
+
+                blend_span_coverage(row + x, count, flatPixel, coverage);
+                x += count;
+            }
+            continue;
+        }
+
+        // Generic path: gradients (anti-aliased fringes) and coloured textures
+        for (int x = spanBegin; x < spanEnd; ++x)
+        {
+            uint32_t r = (uint32_t)std::min(std::max(value[2], 0.0f), 255.0f);
+            uint32_t g = (uint32_t)std::min(std::max(value[3], 0.0f), 255.0f);
+            uint32_t b = (uint32_t)std::min(std::max(value[4], 0.0f), 255.0f);
+            uint32_t a = (uint32_t)std::min(std::max(value[5], 0.0f), 255.0f);
+
+            if (tex != nullptr)
+            {
+                const uint8_t *texel = sample_texel(tex, value[0], value[1]);
+                r = div255(r * texel[0]);
+                g = div255(g * texel[1]);
+                b = div255(b * texel[2]);
+                a = div255(a * texel[3]);
+            }
+
+            if (a != 0)
+                row[x] = blend_pixel(row[x], _packColor(r, g, b), a);
+
+            for (int k = 0; k < 6; ++k)
+                value[k] += attrStep[k];
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// SoftRenderer
+
+struct SoftRenderer::X11State {
+    Display *display = nullptr;
+    Window window = 0;
+    Visual *visual = nullptr;
+    int depth = 0;
+    GC gc = nullptr;
+
+    bool useShm = false;
+    XShmSegmentInfo shmInfo = {};
+    XImage *image = nullptr;
+};
+
+SoftRenderer::SoftRenderer() :
+    fX11(nullptr)
+{
+}
+
+SoftRenderer::~SoftRenderer()
+{
+    shutdown();
+}
+
+bool SoftRenderer::init(GLFWwindow *window)
+{
+    // Font atlas. Our own texture struct is the ImTextureID.
+    ImGuiIO &io = ImGui::GetIO();
+
+    unsigned char *pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    fFontTexture.width = width;
+    fFontTexture.height = height;
+    fFontTexture.pixels = pixels;
+    fFontTexture.whiteRgb = true;
+    for (size_t i = 0; i < (size_t)width * (size_t)height && fFontTexture.whiteRgb; ++i)
+        fFontTexture.whiteRgb = pixels[i * 4] == 255 && pixels[i * 4 + 1] == 255 && pixels[i * 4 + 2] == 255;
+
+    io.Fonts->SetTexID((ImTextureID)&fFontTexture);
+    io.BackendRendererName = "imgui_impl_soft";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+
+    /**
+     * Use our own X connection.
+     * GLFW's connection is driven by glfwPollEvents() on the main thread, and
+     * we are on the drawing thread. Window IDs are valid across connections.
+     */
+    fX11 = new X11State;
+    fX11->display = XOpenDisplay(nullptr);
+    if (fX11->display == nullptr)
+    {
+        d_stderr2("Software renderer: cannot open X display");
+        shutdown();
+        return false;
+    }
+
+    fX11->window = glfwGetX11Window(window);
+
+    XWindowAttributes attrs;
+    if (!XGetWindowAttributes(fX11->display, fX11->window, &attrs) || (attrs.depth != 24 && attrs.depth != 32))
+    {
+        d_stderr2("Software renderer: unsupported window visual");
+        shutdown();
+        return false;
+    }
+
+    fX11->visual = attrs.visual;
+    fX11->depth = attrs.depth;
+    fX11->gc = XCreateGC(fX11->display, fX11->window, 0, nullptr);
+
+    fRasterizer.setBgra(fX11->visual->red_mask == 0xff0000);
+    fRasterizer.startWorkers();
+
+    // MIT-SHM only works when the server is on this machine
+    const char *displayName = DisplayString(fX11->display);
+    const bool localDisplay = displayName != nullptr && (displayName[0] == ':' || std::strncmp(displayName, "unix:", 5) == 0);
+    fX11->useShm = localDisplay && XShmQueryExtension(fX11->display);
+
+    return true;
+}
+
+void SoftRenderer::shutdown()
+{
+    fRasterizer.stopWorkers();
+
+    if (fX11 != nullptr)
+    {
+        _destroyImage();
+
+        if (fX11->gc != nullptr)
+            XFreeGC(fX11->display, fX11->gc);
+        if (fX11->display != nullptr)
+            XCloseDisplay(fX11->display);
+
+        delete fX11;
+        fX11 = nullptr;
+    }
+
+    if (fFontTexture.pixels != nullptr && ImGui::GetCurrentContext() != nullptr)
+    {
+        ImGuiIO &io = ImGui::GetIO();
+        io.Fonts->SetTexID(0);
+        io.BackendRendererName = nullptr;
+        io.BackendFlags &= ~ImGuiBackendFlags_RendererHasVtxOffset;
+    }
+    fFontTexture = SoftTexture();
+}
+
+bool SoftRenderer::_createImage(int width, int height)
+{
+    X11State &x = *fX11;
+
+    if (x.useShm)
+    {
+        x.image = XShmCreateImage(x.display, x.visual, x.depth, ZPixmap, nullptr, &x.shmInfo, width, height);
+
+        if (x.image != nullptr)
+        {
+            x.shmInfo.shmid = shmget(IPC_PRIVATE, (size_t)x.image->bytes_per_line * x.image->height, IPC_CREAT | 0600);
+            x.shmInfo.shmaddr = x.shmInfo.shmid >= 0 ? (char *)shmat(x.shmInfo.shmid, nullptr, 0) : (char *)-1;
+            x.shmInfo.readOnly = False;
+
+            if (x.shmInfo.shmaddr != (char *)-1 && XShmAttach(x.display, &x.shmInfo))
+            {
+                XSync(x.display, False);
+
+                // Segment goes away by itself once both sides have detached
+                shmctl(x.shmInfo.shmid, IPC_RMID, nullptr);
+
+                x.image->data = x.shmInfo.shmaddr;
+                if (x.image->bits_per_pixel == 32)
+                    return true;
+
+                _destroyImage();
+                return false;
+            }
+
+            // Fall back to plain XPutImage for good
+            d_stderr2("Software renderer: MIT-SHM unavailable, falling back to XPutImage");
+
+            if (x.shmInfo.shmaddr != (char *)-1)
+                shmdt(x.shmInfo.shmaddr);
+            if (x.shmInfo.shmid >= 0)
+                shmctl(x.shmInfo.shmid, IPC_RMID, nullptr);
+
+            XDestroyImage(x.image);
+            x.image = nullptr;
+        }
+
+        x.useShm = false;
+    }
+
+    x.image = XCreateImage(x.display, x.visual, x.depth, ZPixmap, 0, nullptr, width, height, 32, 0);
+    if (x.image == nullptr)
+        return false;
+
+    // Freed by XDestroyImage()
+    x.image->data = (char *)std::malloc((size_t)x.image->bytes_per_line * x.image->height);
+
+    if (x.image->data == nullptr || x.image->bits_per_pixel != 32)
+    {
+        _destroyImage();
+        return false;
+    }
+
+    return true;
+}
+
+void SoftRenderer::_destroyImage()
+{
+    X11State &x = *fX11;
+
+    if (x.image == nullptr)
+        return;
+
+    if (x.useShm)
+    {
+        XShmDetach(x.display, &x.shmInfo);
+        XSync(x.display, False);
+        XDestroyImage(x.image);
+        shmdt(x.shmInfo.shmaddr);
+    }
+    else
+    {
+        XDestroyImage(x.image);
+    }
+
+    x.image = nullptr;
+}
+
+void SoftRenderer::render(ImDrawData *drawData, int width, int height, const ImVec4 &clearColor)
+{
+    if (fX11 == nullptr || width <= 0 || height <= 0)
+        return;
+
+    if (fX11->image == nullptr || fX11->image->width != width || fX11->image->height != height)
+    {
+        _destroyImage();
+        if (!_createImage(width, height))
+            return;
+    }
+
+    // Render straight into the image we are going to present, no extra copy
+    fRasterizer.render(drawData, (uint32_t *)fX11->image->data, width, height, fX11->image->bytes_per_line / 4, clearColor);
+}
+
+void SoftRenderer::present()
+{
+    if (fX11 == nullptr || fX11->image == nullptr)
+        return;
+
+    X11State &x = *fX11;
+
+    if (x.useShm)
+        XShmPutImage(x.display, x.window, x.gc, x.image, 0, 0, 0, 0, x.image->width, x.image->height, False);
+    else
+        XPutImage(x.display, x.window, x.gc, x.image, 0, 0, 0, 0, x.image->width, x.image->height);
+
+    // The server must be done reading the image before we render into it again
+    XSync(x.display, False);
+}
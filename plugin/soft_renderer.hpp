@@ -0,0 +1,154 @@
+/*
+ *  soft_renderer.hpp - CPU renderer for ImGui draw data, presented via MIT-SHM
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * On machines without a GPU, Mesa's generic GL path makes
+ * ImGui_ImplOpenGL2_RenderDrawData() very slow at large editor sizes.
+ * This renderer rasterises ImDrawData triangles straight into the
+ * XImage we present, bypassing GL entirely.
+ *
+ * Only built with -DGLFW_BACKEND_SOFTWARE_RENDERER=ON (X11 only), and only
+ * used when GLFW_BACKEND_SOFTWARE_RENDERER=1 is set in the environment.
+ * The window is then created with GLFW_NO_API, so none of the GL calls in
+ * PluginUI.cpp may be made.
+ */
+
+#pragma once
+
+#include <imgui.h>
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Texture as seen by the rasteriser.
+ * Use a pointer to it as ImTextureID. Pixels are in ImGui's RGBA32 byte order.
+ */
+struct SoftTexture {
+    int width = 0;
+    int height = 0;
+    const uint8_t *pixels = nullptr;
+    bool whiteRgb = false;      // Alpha-only content, like ImGui's font atlas
+};
+
+/**
+ * Window-system independent part: rasterise ImDrawData into a 32-bit framebuffer.
+ *
+ * The framebuffer is split into tiles. render() first bins every triangle into
+ * the tiles its clipped bounding box touches, in submission order. Tiles are
+ * then picked up by a small worker pool plus the calling thread, and each one
+ * only sets up the triangles binned to it. Tiles never share pixels, so they
+ * need no synchronisation with each other.
+ */
+class SoftRasterizer {
+public:
+    // threadCount = 0 picks a sensible default for this machine. Threads are only spawned by startWorkers().
+    explicit SoftRasterizer(unsigned threadCount = 0);
+    ~SoftRasterizer();
+
+    // Spawn the worker threads. Until then, render() does all tiles on the calling thread.
+    void startWorkers();
+    void stopWorkers();
+
+    // Pixel order in the framebuffer. BGRA is 0xAARRGGBB as little-endian uint32, the usual X11 layout.
+    void setBgra(bool bgra) { fBgra = bgra; }
+
+    // Rasterise the whole frame. stride is in pixels.
+    void render(const ImDrawData *drawData, uint32_t *pixels, int width, int height, int stride, const ImVec4 &clearColor);
+
+private:
+    // A draw command, with its clip rect in framebuffer pixels
+    struct BinnedCommand {
+        int clip[4];
+        const SoftTexture *tex;
+    };
+
+    struct BinnedTriangle {
+        const ImDrawVert *v[3];
+        uint32_t command;
+    };
+
+    void _workerLoop(uint64_t lastSerial);
+    void _binTriangles();
+    void _runTiles();
+    void _renderTile(int tile);
+    void _drawTriangle(const ImDrawVert &a, const ImDrawVert &b, const ImDrawVert &c,
+                       const int clip[4], const SoftTexture *tex);
+
+    uint32_t _packColor(uint32_t r, uint32_t g, uint32_t b) const;
+
+    bool fBgra;
+
+    // Current job. Written by render() before waking the workers.
+    const ImDrawData *fDrawData;
+    uint32_t *fPixels;
+    int fWidth, fHeight, fStride;
+    uint32_t fClearPixel;
+    ImVec2 fClipOffset;
+    ImVec2 fClipScale;
+
+    // Bins of the current job. Kept between frames, so they stop allocating once warm.
+    std::vector<BinnedCommand> fCommands;
+    std::vector<std::vector<BinnedTriangle>> fTileBins;
+    int fTilesX, fTilesY;
+    std::atomic<int> fNextTile;
+
+    // Worker pool
+    unsigned fThreadCount;
+    std::vector<std::thread> fWorkers;
+    std::mutex fMutex;
+    std::condition_variable fStartCondition;
+    std::condition_variable fDoneCondition;
+    uint64_t fJobSerial;
+    unsigned fBusyWorkers;
+    bool fQuit;
+};
+
+/**
+ * X11 presentation and ImGui glue around SoftRasterizer.
+ * All methods must be called from the drawing thread.
+ */
+class SoftRenderer {
+public:
+    SoftRenderer();
+    ~SoftRenderer();
+
+    // Build the font texture of the current ImGui context and connect to the X server.
+    bool init(GLFWwindow *window);
+    void shutdown();
+
+    // Rasterise a frame. width/height are the framebuffer size.
+    void render(ImDrawData *drawData, int width, int height, const ImVec4 &clearColor);
+
+    // Show the last rendered frame. Returns once the X server has consumed it.
+    void present();
+
+private:
+    bool _createImage(int width, int height);
+    void _destroyImage();
+
+    SoftRasterizer fRasterizer;
+    SoftTexture fFontTexture;
+
+    struct X11State;
+    X11State *fX11;
+};
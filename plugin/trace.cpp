@@ -0,0 +1,453 @@
+/*
+ *  trace.cpp - Cross-thread tracer with Chrome trace-event export
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "trace.hpp"
+
+#if GLFW_BACKEND_ENABLE_TRACE
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <dlfcn.h>
+#endif
+
+// Per thread ring size. 32 bytes per event, so 2 MiB per thread.
+static constexpr uint64_t kEventsPerThread = 1u << 16;
+
+// Threads we can keep names for
+static constexpr uint32_t kMaxNamedThreads = 1024;
+
+// Rings ever reserved for audio threads. Those never give theirs back, see trace.hpp.
+static constexpr uint32_t kMaxAudioBuffers = 8;
+
+enum TraceEventKind : uint32_t {
+    kTraceEventComplete = 0,
+    kTraceEventCounter
+};
+
+/**
+ * One slot of a thread's ring.
+ * Fields are relaxed atomics, so trace_write_json() may read a slot while its
+ * thread overwrites it. Such slots are detected and skipped, see below.
+ */
+struct TraceEvent {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> startNs;
+    std::atomic<uint64_t> payload;      // End time, or bits of the counter value
+    std::atomic<uint32_t> kind;
+    std::atomic<uint32_t> tid;
+};
+
+/**
+ * Ring buffer owned by one thread at a time. Buffers are never freed: when a
+ * thread exits, the next new thread takes its buffer over, old events included.
+ * Audio rings only go to audio threads, and are never handed over.
+ */
+struct TraceThreadBuffer {
+    TraceEvent events[kEventsPerThread];
+    std::atomic<uint64_t> written { 0 };    // Events ever recorded, published after the slot is written
+    std::atomic<bool> owned { true };
+    bool audio = false;                     // Immutable once the buffer is published
+    TraceThreadBuffer *next = nullptr;      // Immutable once the buffer is published
+};
+
+/**
+ * Trivially destructible: touching it registers nothing for thread exit, which
+ * in the C++ runtime would allocate and take the loader lock. So the audio
+ * thread can use it. Other threads register their release separately, see
+ * TraceThreadRelease.
+ */
+struct TraceThreadState {
+    TraceThreadBuffer *buffer;
+    uint32_t tid;
+    const char *pendingName;
+    bool audio;
+};
+
+static std::atomic<bool> trace_enabled { false };
+static std::atomic<TraceThreadBuffer *> trace_buffers { nullptr };
+static std::atomic<uint32_t> trace_next_tid { 0 };
+static std::atomic<const char *> trace_thread_names[kMaxNamedThreads];
+
+static thread_local TraceThreadState trace_thread;
+
+// Hands the ring of an exiting thread over to the next new one. Never touched by audio threads.
+struct TraceThreadRelease {
+    TraceThreadBuffer *buffer = nullptr;
+
+    ~TraceThreadRelease()
+    {
+        if (buffer != nullptr)
+            buffer->owned.store(false, std::memory_order_release);
+        trace_thread.buffer = nullptr;
+    }
+};
+
+static thread_local TraceThreadRelease trace_thread_release;
+
+// Timestamps in the file are relative to this
+static const uint64_t trace_epoch = monotonic_now_ns();
+
+static uint32_t trace_thread_id()
+{
+    if (trace_thread.tid == 0)
+    {
+        trace_thread.tid = trace_next_tid.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        if (trace_thread.pendingName != nullptr && trace_thread.tid < kMaxNamedThreads)
+            trace_thread_names[trace_thread.tid].store(trace_thread.pendingName, std::memory_order_relaxed);
+    }
+
+    return trace_thread.tid;
+}
+
+static void trace_publish_buffer(TraceThreadBuffer *buffer)
+{
+    buffer->next = trace_buffers.load(std::memory_order_relaxed);
+    while (!trace_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+// Take over a free ring of the given kind. Lock-free, and never allocates.
+static TraceThreadBuffer *trace_claim_buffer(bool audio)
+{
+    for (TraceThreadBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+    {
+        bool owned = false;
+        if (buffer->audio == audio && !buffer->owned.load(std::memory_order_relaxed) &&
+            buffer->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+        {
+            return buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+static TraceThreadBuffer *trace_thread_buffer()
+{
+    if (trace_thread.buffer != nullptr)
+        return trace_thread.buffer;
+
+    // Only what was reserved ahead, and no release at exit. May be none.
+    if (trace_thread.audio)
+        return trace_thread.buffer = trace_claim_buffer(true);
+
+    // Take over the buffer of a thread which has exited, if any
+    TraceThreadBuffer *buffer = trace_claim_buffer(false);
+    if (buffer == nullptr)
+    {
+        // First event of a new thread
+        buffer = new TraceThreadBuffer;
+        trace_publish_buffer(buffer);
+    }
+
+    trace_thread_release.buffer = buffer;
+    return trace_thread.buffer = buffer;
+}
+
+static void trace_record(TraceEventKind kind, const char *name, uint64_t startNs, uint64_t payload)
+{
+    TraceThreadBuffer *const buffer = trace_thread_buffer();
+    if (buffer == nullptr)
+        return;
+
+    const uint64_t index = buffer->written.load(std::memory_order_relaxed);
+
+    TraceEvent &event = buffer->events[index % kEventsPerThread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.startNs.store(startNs, std::memory_order_relaxed);
+    event.payload.store(payload, std::memory_order_relaxed);
+    event.kind.store(kind, std::memory_order_relaxed);
+    event.tid.store(trace_thread_id(), std::memory_order_relaxed);
+
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void trace_complete(const char *name, uint64_t startNs, uint64_t endNs)
+{
+    trace_record(kTraceEventComplete, name, startNs, endNs);
+}
+
+void trace_counter(const char *name, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    trace_record(kTraceEventCounter, name, monotonic_now_ns(), bits);
+}
+
+void trace_set_enabled(bool enabled)
+{
+    trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool trace_is_enabled()
+{
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_reserve_audio_buffer()
+{
+    uint32_t audioBuffers = 0;
+
+    for (TraceThreadBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+    {
+        if (!buffer->audio)
+            continue;
+        if (!buffer->owned.load(std::memory_order_relaxed))
+            return;
+        ++audioBuffers;
+    }
+
+    // Each audio thread keeps its ring, so hosts starting a new one per activation would grow this forever
+    if (audioBuffers >= kMaxAudioBuffers)
+        return;
+
+    // Free for the next audio thread to record its first event
+    TraceThreadBuffer *buffer = new TraceThreadBuffer;
+    buffer->owned.store(false, std::memory_order_relaxed);
+    buffer->audio = true;
+    trace_publish_buffer(buffer);
+}
+
+void trace_set_thread_name(const char *name)
+{
+    // Cheap enough to call every audio block: no buffer is allocated here
+    if (trace_thread.tid == 0)
+        trace_thread.pendingName = name;
+    else if (trace_thread.tid < kMaxNamedThreads)
+        trace_thread_names[trace_thread.tid].store(name, std::memory_order_relaxed);
+}
+
+void trace_set_audio_thread(const char *name)
+{
+    trace_thread.audio = true;
+    trace_set_thread_name(name);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// JSON export
+
+struct TraceEventCopy {
+    const char *name;
+    uint64_t startNs;
+    uint64_t payload;
+    uint32_t kind;
+    uint32_t tid;
+};
+
+static void json_write_string(FILE *file, const char *text)
+{
+    std::fputc('"', file);
+
+    for (const char *p = text; *p != '\0'; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+            std::fprintf(file, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20)
+            std::fprintf(file, "\\u%04x", (unsigned)(unsigned char)*p);
+        else
+            std::fputc(*p, file);
+    }
+
+    std::fputc('"', file);
+}
+
+static double json_timestamp_us(uint64_t ns)
+{
+    return ns >= trace_epoch ? (double)(ns - trace_epoch) / 1000.0 : 0.0;
+}
+
+// Copy out one ring while its thread may keep recording
+static void trace_copy_buffer(const TraceThreadBuffer &buffer, std::vector<TraceEventCopy> &out)
+{
+    const uint64_t written = buffer.written.load(std::memory_order_acquire);
+    const uint64_t first = written > kEventsPerThread ? written - kEventsPerThread : 0;
+
+    std::vector<TraceEventCopy> events;
+    events.reserve((size_t)(written - first));
+
+    for (uint64_t index = first; index < written; ++index)
+    {
+        const TraceEvent &event = buffer.events[index % kEventsPerThread];
+        events.push_back({ event.name.load(std::memory_order_relaxed),
+                           event.startNs.load(std::memory_order_relaxed),
+                           event.payload.load(std::memory_order_relaxed),
+                           event.kind.load(std::memory_order_relaxed),
+                           event.tid.load(std::memory_order_relaxed) });
+    }
+
+    /**
+     * Anything the thread may have overwritten meanwhile is garbage. The writer
+     * is at most working on slot index `after`, which held index `after - N`.
+     */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t after = buffer.written.load(std::memory_order_relaxed);
+    const uint64_t firstValid = after >= kEventsPerThread ? after - kEventsPerThread + 1 : 0;
+
+    for (uint64_t index = first; index < written; ++index)
+    {
+        if (index >= firstValid)
+            out.push_back(events[(size_t)(index - first)]);
+    }
+}
+
+bool trace_write_json(const char *path)
+{
+    FILE *file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    std::vector<TraceEventCopy> events;
+    for (TraceThreadBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+        trace_copy_buffer(*buffer, events);
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first = true;
+
+    const uint32_t threadCount = trace_next_tid.load(std::memory_order_relaxed);
+    for (uint32_t tid = 1; tid <= threadCount && tid < kMaxNamedThreads; ++tid)
+    {
+        const char *const name = trace_thread_names[tid].load(std::memory_order_relaxed);
+        if (name == nullptr)
+            continue;
+
+        std::fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", tid);
+        json_write_string(file, name);
+        std::fputs("}}", file);
+        first = false;
+    }
+
+    for (const TraceEventCopy &event : events)
+    {
+        if (event.name == nullptr)
+            continue;
+
+        std::fprintf(file, "%s{\"pid\":1,\"tid\":%u,\"name\":", first ? "" : ",\n", event.tid);
+        json_write_string(file, event.name);
+
+        if (event.kind == kTraceEventComplete)
+        {
+            const uint64_t durationNs = event.payload > event.startNs ? event.payload - event.startNs : 0;
+            std::fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f}", json_timestamp_us(event.startNs), (double)durationNs / 1000.0);
+        }
+        else
+        {
+            double value;
+            std::memcpy(&value, &event.payload, sizeof(value));
+            std::fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"args\":{\"value\":%.17g}}", json_timestamp_us(event.startNs), value);
+        }
+
+        first = false;
+    }
+
+    std::fputs("\n]}\n", file);
+
+    const bool ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+/**
+ * Name of the binary we are linked into, without directory and extension.
+ * Empty if unknown.
+ */
+static std::string trace_binary_name()
+{
+    std::string path;
+
+#if defined(_WIN32)
+    HMODULE module = nullptr;
+    char buffer[MAX_PATH];
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           (LPCSTR)&trace_binary_name, &module) &&
+        GetModuleFileNameA(module, buffer, sizeof(buffer)) != 0)
+    {
+        path = buffer;
+    }
+#else
+    Dl_info info;
+    if (dladdr((const void *)&trace_binary_name, &info) != 0 && info.dli_fname != nullptr)
+        path = info.dli_fname;
+#endif
+
+    const size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos)
+        path.erase(0, slash + 1);
+
+    const size_t dot = path.find('.');
+    if (dot != std::string::npos)
+        path.erase(dot);
+
+    return path;
+}
+
+/**
+ * GLFW_BACKEND_TRACE=<file> traces from load to unload, for when there is no
+ * code of ours around to call trace_write_json().
+ *
+ * DSP and UI may be separate binaries in one process (LV2), each with its own
+ * tracer. So the binary's name goes into the file name, before the extension:
+ * trace.json becomes trace-<binary>.json.
+ */
+static struct TraceEnvironment {
+    std::string path;
+
+    TraceEnvironment()
+    {
+        const char *const env = std::getenv("GLFW_BACKEND_TRACE");
+        if (env == nullptr || env[0] == '\0')
+            return;
+
+        path = env;
+
+        const std::string binary = trace_binary_name();
+        if (!binary.empty())
+        {
+            const size_t slash = path.find_last_of("/\\");
+            const size_t dot = path.rfind('.');
+            const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+
+            path.insert(hasExtension ? dot : path.size(), "-" + binary);
+        }
+
+        trace_set_enabled(true);
+    }
+
+    ~TraceEnvironment()
+    {
+        if (!path.empty() && !trace_write_json(path.c_str()))
+            std::fprintf(stderr, "Failed to write trace to %s\n", path.c_str());
+    }
+} trace_environment;
+
+#else
+
+void trace_set_enabled(bool) {}
+bool trace_is_enabled() { return false; }
+void trace_reserve_audio_buffer() {}
+void trace_set_thread_name(const char *) {}
+void trace_set_audio_thread(const char *) {}
+bool trace_write_json(const char *) { return false; }
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ *  trace.hpp - Cross-thread tracer with Chrome trace-event export
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Our performance problems span three kinds of threads: the host main thread
+ * (uiIdle(), GLFW callbacks, parameterChanged()), one drawing thread per editor
+ * and the audio thread (run()). This tracer puts all of them on one timeline.
+ *
+ * Build with -DGLFW_BACKEND_ENABLE_TRACE=ON, otherwise the TRACE_* macros
+ * compile to nothing. Tracing then starts disabled: enable it at runtime with
+ * trace_set_enabled(), or by setting the environment variable
+ *
+ *     GLFW_BACKEND_TRACE=/path/to/trace.json
+ *
+ * which also writes the trace when the plugin is unloaded: one file per binary,
+ * named after it, e.g. /path/to/trace-<binary>.json.
+ * trace_write_json() writes it on demand. Open the file in chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * Each thread records into its own fixed-size ring buffer, with no locks and
+ * no allocations except the buffer itself, allocated on the thread's first
+ * event. A thread hands its ring over to the next new thread when it exits.
+ * When a ring is full, the oldest events are overwritten. Event names must be
+ * string literals, or otherwise live forever.
+ *
+ * The audio thread must neither allocate nor lock, not even in the C++ runtime
+ * at thread exit. It declares itself with TRACE_AUDIO_THREAD() and then only
+ * takes a ring reserved ahead of it by trace_reserve_audio_buffer(). Without
+ * one, its events are dropped. Nothing is registered for its exit, so its
+ * ring stays with it, and in the trace, for good.
+ */
+
+#pragma once
+
+#include "monotonic_clock.hpp"
+
+#include <cstdint>
+
+// Enable or disable recording at runtime. Any thread.
+void trace_set_enabled(bool enabled);
+bool trace_is_enabled();
+
+// Make sure a ring is free for the next audio thread. Call it ahead of the
+// audio thread, e.g. from activate(). Any thread but the audio thread.
+void trace_reserve_audio_buffer();
+
+// Name the calling thread in the trace. The name must live forever.
+void trace_set_thread_name(const char *name);
+
+// Name the calling thread, and make it trace only into a reserved ring, see above.
+// Cheap enough for every audio block.
+void trace_set_audio_thread(const char *name);
+
+// Write all recorded events as Chrome trace-event JSON. Returns false if the
+// file could not be written, or tracing is compiled out. Any thread.
+bool trace_write_json(const char *path);
+
+#if GLFW_BACKEND_ENABLE_TRACE
+
+void trace_complete(const char *name, uint64_t startNs, uint64_t endNs);
+void trace_counter(const char *name, double value);
+
+// Records the lifetime of a scope as one complete event.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : fName(name), fStartNs(trace_is_enabled() ? monotonic_now_ns() : 0) {}
+    ~TraceScope()
+    {
+        if (fStartNs != 0)
+            trace_complete(fName, fStartNs, monotonic_now_ns());
+    }
+
+private:
+    const char *fName;
+    uint64_t fStartNs;
+};
+
+# define TRACE_CONCAT_IMPL(a, b) a##b
+# define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+# define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+# define TRACE_COUNTER(name, value) \
+    do { if (trace_is_enabled()) trace_counter(name, (double)(value)); } while (0)
+# define TRACE_SPAN(name, startNs, endNs) \
+    do { if (trace_is_enabled()) trace_complete(name, startNs, endNs); } while (0)
+# define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+# define TRACE_AUDIO_THREAD(name) trace_set_audio_thread(name)
+
+#else
+
+# define TRACE_SCOPE(name) ((void)0)
+# define TRACE_COUNTER(name, value) ((void)0)
+# define TRACE_SPAN(name, startNs, endNs) ((void)0)
+# define TRACE_THREAD_NAME(name) ((void)0)
+# define TRACE_AUDIO_THREAD(name) ((void)0)
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ *  waveform_history.cpp - Long waveform history for the editor, fed by the audio thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "waveform_history.hpp"
+
+#include <algorithm>
+
+// Each pyramid level combines 4 entries of the level below
+static constexpr uint32_t kLevelShift = 2;
+
+// The coarsest level still has this many entries
+static constexpr uint32_t kMinEntriesPerLevel = 64;
+
+// Smallest power of two not below n
+static uint64_t round_up_pow2(uint64_t n)
+{
+    uint64_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// WaveformRing
+
+WaveformRing::WaveformRing() :
+    fBuffer(new float[kCapacity]()),
+    fWritePos(0),
+    fReadPos(0),
+    fReaderAttached(false),
+    fDropped(0)
+{
+}
+
+void WaveformRing::write(const float *left, const float *right, uint32_t frames)
+{
+    if (!fReaderAttached.load(std::memory_order_acquire))
+        return;
+
+    const uint64_t writePos = fWritePos.load(std::memory_order_relaxed);
+    const uint64_t readPos = fReadPos.load(std::memory_order_acquire);
+
+    const uint32_t space = kCapacity - (uint32_t)(writePos - readPos);
+    const uint32_t count = std::min(frames, space);
+
+    if (count < frames)
+        fDropped.fetch_add(frames - count, std::memory_order_relaxed);
+
+    // At most two contiguous spans
+    const uint32_t offset = (uint32_t)(writePos & (kCapacity - 1));
+    const uint32_t first = std::min(count, kCapacity - offset);
+
+    float *const buffer = fBuffer.get();
+    for (uint32_t i = 0; i < first; ++i)
+        buffer[offset + i] = (left[i] + right[i]) * 0.5f;
+    for (uint32_t i = first; i < count; ++i)
+        buffer[i - first] = (left[i] + right[i]) * 0.5f;
+
+    fWritePos.store(writePos + count, std::memory_order_release);
+}
+
+bool WaveformRing::attachReader()
+{
+    bool attached = false;
+    if (!fReaderAttached.compare_exchange_strong(attached, true, std::memory_order_acq_rel))
+        return false;
+
+    // Whatever is in there is old. The writer may add a few samples meanwhile, that's fine.
+    fReadPos.store(fWritePos.load(std::memory_order_acquire), std::memory_order_release);
+    return true;
+}
+
+void WaveformRing::detachReader()
+{
+    fReaderAttached.store(false, std::memory_order_release);
+}
+
+uint32_t WaveformRing::read(float *dst, uint32_t maxFrames)
+{
+    const uint64_t readPos = fReadPos.load(std::memory_order_relaxed);
+    const uint64_t writePos = fWritePos.load(std::memory_order_acquire);
+
+    const uint32_t count = std::min(maxFrames, (uint32_t)(writePos - readPos));
+
+    const uint32_t offset = (uint32_t)(readPos & (kCapacity - 1));
+    const uint32_t first = std::min(count, kCapacity - offset);
+
+    std::copy(fBuffer.get() + offset, fBuffer.get() + offset + first, dst);
+    std::copy(fBuffer.get(), fBuffer.get() + (count - first), dst + first);
+
+    fReadPos.store(readPos + count, std::memory_order_release);
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// WaveformHistory
+
+WaveformHistory::WaveformHistory(uint32_t capacityLog4, uint32_t maxColumns) :
+    fCapacity((uint64_t)1 << (capacityLog4 * kLevelShift)),
+    fMaxColumns(maxColumns),
+    fWritten(0)
+{
+    /**
+     * Raw samples are read for less than 4 per column, level k for less than
+     * 4^(k+1) samples per column. Either way less than 4 entries per column,
+     * plus one sticking out at each end, plus the slot shared by the oldest and
+     * the newest entry.
+     */
+    const uint64_t recentEntries = std::min(fCapacity, round_up_pow2(((uint64_t)maxColumns << kLevelShift) + 3));
+
+    fSamples.assign((size_t)recentEntries, 0.0f);
+    fMask = recentEntries - 1;
+
+    for (uint32_t shift = kLevelShift; (fCapacity >> shift) >= kMinEntriesPerLevel; shift += kLevelShift)
+    {
+        // The coarsest level covers the whole history
+        const bool coarsest = (fCapacity >> (shift + kLevelShift)) < kMinEntriesPerLevel;
+        const size_t entries = (size_t)(coarsest ? fCapacity >> shift : std::min(fCapacity >> shift, recentEntries));
+
+        Level level;
+        level.shift = shift;
+        level.mask = entries - 1;
+        level.mins.assign(entries, 0.0f);
+        level.maxs.assign(entries, 0.0f);
+
+        fLevels.push_back(std::move(level));
+    }
+}
+
+void WaveformHistory::append(const float *samples, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    // Anything beyond capacity would be overwritten right away
+    if (count > fCapacity)
+    {
+        fWritten += count - fCapacity;
+        samples += count - fCapacity;
+        count = (uint32_t)fCapacity;
+    }
+
+    /**
+     * Levels are built from the entries below them, starting up to a block
+     * before the new samples. So feed at most half a ring at a time, or the
+     * start of a block could be overwritten before it is read.
+     */
+    const uint32_t maxStep = (uint32_t)(fSamples.size() / 2);
+    while (count > maxStep)
+    {
+        append(samples, maxStep);
+        samples += maxStep;
+        count -= maxStep;
+    }
+
+    const uint64_t first = fWritten;
+
+    for (uint32_t i = 0; i < count; ++i)
+        fSamples[(first + i) & fMask] = samples[i];
+
+    fWritten += count;
+
+    // Sample range [first, fWritten) is new. Every level only redoes the entries covering it.
+    for (size_t i = 0; i < fLevels.size(); ++i)
+        _updateLevel(i, first, fWritten - 1);
+}
+
+void WaveformHistory::_updateLevel(size_t index, uint64_t first, uint64_t last)
+{
+    Level &level = fLevels[index];
+
+    for (uint64_t entry = first >> level.shift; entry <= (last >> level.shift); ++entry)
+    {
+        // Children: samples (level 0) or entries of the level below, limited to what has been written
+        float lo, hi;
+
+        if (index == 0)
+        {
+            const uint64_t begin = entry << level.shift;
+            const uint64_t end = std::min(begin + ((uint64_t)1 << level.shift), fWritten);
+
+            lo = hi = fSamples[begin & fMask];
+            for (uint64_t s = begin + 1; s < end; ++s)
+            {
+                lo = std::min(lo, fSamples[s & fMask]);
+                hi = std::max(hi, fSamples[s & fMask]);
+            }
+        }
+        else
+        {
+            const Level &below = fLevels[index - 1];
+            const uint64_t begin = entry << kLevelShift;
+            const uint64_t end = std::min(begin + ((uint64_t)1 << kLevelShift), ((fWritten - 1) >> below.shift) + 1);
+
+            lo = below.mins[begin & below.mask];
+            hi = below.maxs[begin & below.mask];
+            for (uint64_t c = begin + 1; c < end; ++c)
+            {
+                lo = std::min(lo, below.mins[c & below.mask]);
+                hi = std::max(hi, below.maxs[c & below.mask]);
+            }
+        }
+
+        level.mins[entry & level.mask] = lo;
+        level.maxs[entry & level.mask] = hi;
+    }
+}
+
+void WaveformHistory::update(WaveformRing &ring)
+{
+    float chunk[4096];
+
+    uint32_t count;
+    while ((count = ring.read(chunk, sizeof(chunk) / sizeof(chunk[0]))) > 0)
+        append(chunk, count);
+}
+
+uint64_t WaveformHistory::getCapacity() const
+{
+    /**
+     * The oldest entry of a level shares its slot with the newest, partially
+     * filled one. Keep one block of the coarsest level as a safety margin.
+     */
+    const uint64_t margin = fLevels.empty() ? 0 : (uint64_t)1 << fLevels.back().shift;
+    return fCapacity - margin;
+}
+
+uint64_t WaveformHistory::getAvailable() const
+{
+    return std::min(fWritten, getCapacity());
+}
+
+uint32_t WaveformHistory::query(uint64_t span, uint32_t columns, float *mins, float *maxs) const
+{
+    if (columns == 0)
+        return 0;
+
+    std::fill(mins, mins + columns, 0.0f);
+    std::fill(maxs, maxs + columns, 0.0f);
+
+    // Finer levels than we keep would be needed, see file comment
+    const uint64_t available = getAvailable();
+    if (span == 0 || available == 0 || columns > fMaxColumns)
+        return columns;
+
+    // Coarsest level whose blocks are no longer than a column. -1 means raw samples.
+    const double samplesPerColumn = (double)span / columns;
+
+    int levelIndex = -1;
+    while (levelIndex + 1 < (int)fLevels.size() && (double)((uint64_t)1 << fLevels[levelIndex + 1].shift) <= samplesPerColumn)
+        ++levelIndex;
+
+    // Sample positions are relative to the history, which may be shorter than the span
+    const int64_t spanStart = (int64_t)fWritten - (int64_t)span;
+    const int64_t oldest = (int64_t)(fWritten - available);
+
+    uint32_t firstColumn = columns;
+
+    for (uint32_t column = 0; column < columns; ++column)
+    {
+        int64_t begin = spanStart + (int64_t)(column * samplesPerColumn);
+        const int64_t end = spanStart + (int64_t)((column + 1) * samplesPerColumn);
+
+        if (end <= oldest)
+            continue;
+
+        begin = std::max(begin, oldest);
+        if (begin >= end)
+            continue;
+
+        float lo, hi;
+
+        if (levelIndex < 0)
+        {
+            lo = hi = fSamples[(uint64_t)begin & fMask];
+            for (int64_t s = begin + 1; s < end; ++s)
+            {
+                lo = std::min(lo, fSamples[(uint64_t)s & fMask]);
+                hi = std::max(hi, fSamples[(uint64_t)s & fMask]);
+            }
+        }
+        else
+        {
+            // Entries overlapping the column. Edge entries may stick out a little, that's invisible at this zoom.
+            const Level &level = fLevels[levelIndex];
+            const uint64_t firstEntry = (uint64_t)begin >> level.shift;
+            const uint64_t lastEntry = (uint64_t)(end - 1) >> level.shift;
+
+            lo = level.mins[firstEntry & level.mask];
+            hi = level.maxs[firstEntry & level.mask];
+            for (uint64_t e = firstEntry + 1; e <= lastEntry; ++e)
+            {
+                lo = std::min(lo, level.mins[e & level.mask]);
+                hi = std::max(hi, level.maxs[e & level.mask]);
+            }
+        }
+
+        mins[column] = lo;
+        maxs[column] = hi;
+        firstColumn = std::min(firstColumn, column);
+    }
+
+    return firstColumn;
+}
@@ -0,0 +1,140 @@
+/*
+ *  waveform_history.hpp - Long waveform history for the editor, fed by the audio thread
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Drawing minutes of audio as one point per sample means millions of vertices
+ * per frame. Instead:
+ *
+ *   DSP: run() pushes a mono mix of its output into a WaveformRing, a lock-free
+ *        single-producer single-consumer ring. Nothing is pushed while no
+ *        editor is reading.
+ *
+ *   UI:  The drawing thread drains the ring into a WaveformHistory, which keeps
+ *        the raw samples plus a min/max pyramid: level k holds min/max of
+ *        blocks of 4^k samples. Appending updates only the entries covering
+ *        new samples, so it costs O(new samples), whatever the history length.
+ *
+ * To draw, query() picks the coarsest level whose blocks still fit in one
+ * pixel column, and combines at most a handful of entries per column. Cost is
+ * O(columns) at any zoom, and one vertex pair per column goes to ImDrawList.
+ *
+ * So a level is only ever read for spans of less than 4 blocks per column,
+ * except the coarsest one. With at most maxColumns columns, the raw samples
+ * and every level but the coarsest only keep their latest 4 * maxColumns
+ * entries or so. Only the coarsest level covers the whole history. 87 s of
+ * history at 48 kHz takes about 0.6 MiB instead of 27 MiB.
+ *
+ * The UI finds the ring of its DSP through the plugin instance pointer (direct
+ * access), see WaveformSource.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WaveformRing {
+public:
+    // About 1.4 s at 48 kHz, way more than the drawing thread needs between two frames
+    static constexpr uint32_t kCapacity = 1u << 16;
+
+    WaveformRing();
+
+    // Audio thread: push (left + right) / 2. Lock-free and allocation-free.
+    // Does nothing without a reader. Drops what doesn't fit.
+    void write(const float *left, const float *right, uint32_t frames);
+
+    // Reader side. Only one reader may be attached at a time.
+    // attachReader() returns false if there already is one. It skips anything stale.
+    bool attachReader();
+    void detachReader();
+
+    // Reader: take up to maxFrames samples, returns how many
+    uint32_t read(float *dst, uint32_t maxFrames);
+
+    // Samples dropped because the reader fell behind
+    uint64_t getDroppedCount() const { return fDropped.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<float[]> fBuffer;
+    std::atomic<uint64_t> fWritePos;    // Written by audio thread
+    std::atomic<uint64_t> fReadPos;     // Written by reader
+    std::atomic<bool> fReaderAttached;
+    std::atomic<uint64_t> fDropped;
+};
+
+// ------------------------------------------------------------------------------------------------------------
+
+class WaveformHistory {
+public:
+    // Spans up to 4^capacityLog4 samples, queried in up to maxColumns columns.
+    // Default: 2^22 samples, about 87 s at 48 kHz, in up to 4095 columns. 0.6 MiB in total.
+    explicit WaveformHistory(uint32_t capacityLog4 = 11, uint32_t maxColumns = 4095);
+
+    // Append samples, updating only the pyramid entries which cover them
+    void append(const float *samples, uint32_t count);
+
+    // Drain a ring into the history
+    void update(WaveformRing &ring);
+
+    // Samples which can be queried once the history is full, and right now
+    uint64_t getCapacity() const;
+    uint64_t getAvailable() const;
+
+    uint32_t getMaxColumns() const { return fMaxColumns; }
+
+    /**
+     * Min/max envelope of the latest `span` samples in `columns` columns, oldest
+     * first. Columns older than the history are left out: returns the index of
+     * the first filled column, the ones before it are zeroed.
+     * More than getMaxColumns() columns are all left out.
+     */
+    uint32_t query(uint64_t span, uint32_t columns, float *mins, float *maxs) const;
+
+private:
+    struct Level {
+        uint32_t shift;             // Entries cover 1 << shift samples
+        uint64_t mask;
+        std::vector<float> mins;
+        std::vector<float> maxs;
+    };
+
+    void _updateLevel(size_t index, uint64_t first, uint64_t last);
+
+    std::vector<float> fSamples;    // Latest samples only, see file comment
+    uint64_t fMask;
+    uint64_t fCapacity;
+    uint32_t fMaxColumns;
+    std::vector<Level> fLevels;
+    uint64_t fWritten;              // Samples ever appended
+};
+
+// ------------------------------------------------------------------------------------------------------------
+
+/**
+ * Implemented by the plugin, so the UI can reach its ring through
+ * UI::getPluginInstancePointer(). A virtual call, which also works when DSP
+ * and UI are separate binaries in one process (LV2 instance access).
+ */
+class WaveformSource {
+public:
+    virtual std::shared_ptr<WaveformRing> getWaveformRing() const = 0;
+
+protected:
+    ~WaveformSource() = default;
+};
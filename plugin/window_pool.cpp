@@ -0,0 +1,155 @@
+/*
+ *  window_pool.cpp - Warm pool of editor windows for fast editor reopen
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "window_pool.hpp"
+
+#include "monotonic_clock.hpp"
+
+#include <GLFW/glfw3native.h>
+
+#include "imgui_internal.h"
+
+#include <cfloat>
+
+static uint64_t pool_now_ms()
+{
+    return monotonic_now_ns() / 1000000;
+}
+
+EditorWindowPool &EditorWindowPool::instance()
+{
+    static EditorWindowPool pool;
+    return pool;
+}
+
+bool EditorWindowPool::acquire(PooledEditorWindow &entry)
+{
+    if (fEntries.empty())
+        return false;
+
+    // Most recent first: the likeliest to still be warm in caches and driver
+    entry = fEntries.back();
+    fEntries.pop_back();
+
+    return true;
+}
+
+bool EditorWindowPool::release(PooledEditorWindow entry)
+{
+    if (fEntries.size() >= kCapacity)
+        return false;
+
+    entry.releasedAtMs = pool_now_ms();
+    fEntries.push_back(entry);
+
+    return true;
+}
+
+std::vector<PooledEditorWindow> EditorWindowPool::takeExpired()
+{
+    std::vector<PooledEditorWindow> expired;
+    const uint64_t now = pool_now_ms();
+
+    for (auto it = fEntries.begin(); it != fEntries.end(); )
+    {
+        if (now - it->releasedAtMs >= kMaxAgeMs)
+        {
+            expired.push_back(*it);
+            it = fEntries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return expired;
+}
+
+std::vector<PooledEditorWindow> EditorWindowPool::takeAll()
+{
+    std::vector<PooledEditorWindow> all;
+    all.swap(fEntries);
+    return all;
+}
+
+void editor_window_attach(GLFWwindow *window, uintptr_t parentWindowHandle)
+{
+#if defined(GLFW_EXPOSE_NATIVE_WIN32)
+    ::SetParent(glfwGetWin32Window(window), (HWND)parentWindowHandle);
+#elif defined(GLFW_EXPOSE_NATIVE_X11)
+    XReparentWindow(glfwGetX11Display(), glfwGetX11Window(window), (Window)parentWindowHandle, 0, 0);
+#endif
+
+    glfwSetWindowPos(window, 0, 0);
+    glfwShowWindow(window);
+}
+
+void editor_window_detach(GLFWwindow *window)
+{
+    glfwHideWindow(window);
+
+    /**
+     * A child window dies with its parent. Move ours somewhere the host can't
+     * destroy it: a message-only window on Win32, the root window on X11.
+     */
+#if defined(GLFW_EXPOSE_NATIVE_WIN32)
+    ::SetParent(glfwGetWin32Window(window), HWND_MESSAGE);
+#elif defined(GLFW_EXPOSE_NATIVE_X11)
+    Display *display = glfwGetX11Display();
+    XReparentWindow(display, glfwGetX11Window(window), DefaultRootWindow(display), 0, 0);
+    XFlush(display);
+#endif
+}
+
+void editor_imgui_reset(ImGuiContext *context)
+{
+    ImGui::SetCurrentContext(context);
+
+    ImGuiContext &g = *context;
+    ImGuiIO &io = g.IO;
+
+    // Shutdown() lets go of the atlas, and newer ImGui asserts no backend is left.
+    // Both are meant to stay, so keep them aside.
+    ImFontAtlas *const fonts = io.Fonts;
+    void *const platformUserData = io.BackendPlatformUserData;
+    void *const rendererUserData = io.BackendRendererUserData;
+
+    io.BackendPlatformUserData = nullptr;
+    io.BackendRendererUserData = nullptr;
+
+    // Windows, settings, focus, popups, storage, ID stacks. Saves the .ini like DestroyContext() would.
+    ImGui::Shutdown();
+
+    // Settings are loaded again by the next frame, as for a new context
+    g.SettingsLoaded = false;
+    ImGui::Initialize();
+
+    io.Fonts = fonts;
+    io.BackendPlatformUserData = platformUserData;
+    io.BackendRendererUserData = rendererUserData;
+
+    // The demo's style editor may have changed it. The owner applies its own colors again.
+    g.Style = ImGuiStyle();
+
+    // Input lives in io, which survives: held keys and buttons, mouse position.
+    // Drop what is still queued, then release everything on the next frame.
+    g.InputEventsQueue.resize(0);
+    io.AddFocusEvent(false);
+    io.AddMousePosEvent(-FLT_MAX, -FLT_MAX);
+    for (int button = 0; button < ImGuiMouseButton_COUNT; ++button)
+        io.AddMouseButtonEvent(button, false);
+}
@@ -0,0 +1,91 @@
+/*
+ *  window_pool.hpp - Warm pool of editor windows for fast editor reopen
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Hosts tear down and recreate editors every time the user toggles a plugin
+ * window. A full cycle creates a GLFW window and GL context, then an ImGui
+ * context with its backends, font atlas and font texture.
+ *
+ * Instead, a closed editor parks its window here: hidden, reparented to the
+ * root window, with its GL context and its ImGui context, backends included.
+ * The next editor to open takes it and reparents it into its host window.
+ * Before parking, editor_imgui_reset() takes the ImGui context back to where
+ * a new one starts (windows, focus, popups, storage, style and input), only
+ * backends and font atlas stay. So a warm editor looks like a cold one.
+ *
+ * The pool is capped, and entries expire after a while: an expired entry is
+ * destroyed by the next editor to open or idle, instead of being reused.
+ * The pool outlives the last editor, so reopening it is warm too, and is
+ * drained at library unload. Destroying an entry is up to the caller (see
+ * PluginUI.cpp), since it involves GLFW's reference count.
+ *
+ * Pool functions must be called from the main thread, like any GLFW window function.
+ */
+
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ImFontAtlas;
+struct ImGuiContext;
+
+struct PooledEditorWindow {
+    GLFWwindow *window = nullptr;           // GL context not current on any thread
+    ImGuiContext *imguiContext = nullptr;   // Backends initialised, state reset by editor_imgui_reset()
+    ImFontAtlas *fontAtlas = nullptr;       // Shared into imguiContext, font texture in the GL context
+    uint64_t releasedAtMs = 0;
+};
+
+class EditorWindowPool {
+public:
+    static constexpr size_t kCapacity = 2;
+    static constexpr uint64_t kMaxAgeMs = 60 * 1000;
+
+    static EditorWindowPool &instance();
+
+    // Take the most recently parked window. Returns false if the pool is empty.
+    bool acquire(PooledEditorWindow &entry);
+
+    // Park a window. Returns false if the pool is full, then the caller must destroy it.
+    bool release(PooledEditorWindow entry);
+
+    // Remove and return entries older than kMaxAgeMs.
+    std::vector<PooledEditorWindow> takeExpired();
+
+    // Remove and return all entries.
+    std::vector<PooledEditorWindow> takeAll();
+
+    size_t size() const { return fEntries.size(); }
+
+private:
+    EditorWindowPool() = default;
+
+    std::vector<PooledEditorWindow> fEntries;
+};
+
+// Reparent an editor window into a host window and show it.
+void editor_window_attach(GLFWwindow *window, uintptr_t parentWindowHandle);
+
+// Hide an editor window and move it out of its host window, so the host can destroy its own window safely.
+void editor_window_detach(GLFWwindow *window);
+
+// Take an ImGui context back to the state of a new one, keeping its backends and font atlas.
+// Call it from the thread which draws with it, while nobody feeds it input.
+void editor_imgui_reset(ImGuiContext *context);
@@ -0,0 +1,264 @@
+/*
+ *  dsp_kernels_check.cpp - Bit-exactness and throughput of the DSP kernel variants
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Runs every kernel of every variant this CPU supports against the scalar
+ * reference, on buffers shifted off any SIMD alignment and on lengths around
+ * each vector width, so that every head, body and tail path is taken. Results
+ * must be bit-identical, and nothing past the end of a buffer may be written.
+ * Inputs mix normal values, denormals and signed zeros.
+ *
+ * Then times each kernel per variant on 512-frame blocks.
+ */
+
+#include "dsp_kernels.hpp"
+
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+static const char* const kVariants[] = { "scalar", "sse2", "avx2", "avx512" };
+
+// Untouched floats around each buffer, to catch out-of-bounds stores. Keeps the buffer start 64-byte aligned.
+static constexpr uint32_t kGuard = 16;
+static constexpr float kGuardValue = 1234.5f;
+
+/**
+ * One kernel call. Buffers 0 and 1 are outputs (and accumulators), 2 and 3 are inputs.
+ * Returns the kernel's result, or 0 for kernels without one.
+ */
+struct KernelCase {
+    const char* name;
+    float (*run)(const DspKernels& k, float* const buf[4], uint32_t frames);
+};
+
+static const KernelCase kCases[] = {
+    { "copy",            [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.copy(buf[0], buf[2], frames); return 0.0f; } },
+    { "copy in place",   [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.copy(buf[0], buf[0], frames); return 0.0f; } },
+    { "gain",            [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.gain(buf[0], buf[2], 0.7f, frames); return 0.0f; } },
+    { "gain in place",   [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.gain(buf[0], buf[0], -1.3f, frames); return 0.0f; } },
+    { "gainRamp",        [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.gainRamp(buf[0], buf[2], 0.25f, 1.5f, frames); return 0.0f; } },
+    { "gainRamp in place", [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.gainRamp(buf[0], buf[0], 1.0f, 0.0f, frames); return 0.0f; } },
+    { "pan",             [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.pan(buf[0], buf[1], buf[2], 0.3f, 0.9f, frames); return 0.0f; } },
+    { "mixStereo",       [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.mixStereo(buf[0], buf[1], buf[2], buf[3], 0.6f, frames); return 0.0f; } },
+    { "sum",             [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.sum(buf[0], buf[2], buf[3], frames); return 0.0f; } },
+    { "sum in place",    [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.sum(buf[0], buf[0], buf[3], frames); return 0.0f; } },
+    { "multiplyAdd",     [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.multiplyAdd(buf[0], buf[2], buf[3], frames); return 0.0f; } },
+    { "peak",            [](const DspKernels& k, float* const buf[4], uint32_t frames) { return k.peak(buf[2], frames); } },
+    { "flushDenormals",  [](const DspKernels& k, float* const buf[4], uint32_t frames) { k.flushDenormals(buf[0], frames); return 0.0f; } },
+};
+
+// Audio-range values. Unless plain, with denormals, signed zeros and values right at FLT_MIN mixed in.
+static float random_sample(std::mt19937& rng, bool plain)
+{
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> denormal(-FLT_MIN, FLT_MIN);
+
+    if (plain)
+        return value(rng);
+
+    switch (rng() % 16)
+    {
+    case 0:
+        return denormal(rng);
+    case 1:
+        return -0.0f;
+    case 2:
+        return (rng() & 1) ? FLT_MIN : -FLT_MIN;
+    default:
+        return value(rng);
+    }
+}
+
+/**
+ * Four guarded buffers of frames floats, starting offset floats past a 64-byte boundary.
+ * Filled from seed, so two sets with the same arguments hold the same bits.
+ */
+struct BufferSet {
+    std::vector<float> storage[4];
+    float* buf[4];
+
+    BufferSet(uint32_t offset, uint32_t frames, uint32_t seed, bool plain = false)
+    {
+        std::mt19937 rng(seed);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // One extra cache line so the start can be aligned by hand
+            storage[i].assign(kGuard + offset + frames + kGuard + 16, kGuardValue);
+
+            float* base = storage[i].data();
+            while ((reinterpret_cast<uintptr_t>(base) & 63) != 0)
+                ++base;
+
+            buf[i] = base + kGuard + offset;
+            for (uint32_t j = 0; j < frames; ++j)
+                buf[i][j] = random_sample(rng, plain);
+        }
+    }
+
+    bool guardsIntact(uint32_t frames) const
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (uint32_t j = 1; j <= kGuard; ++j)
+            {
+                if (buf[i][-(int)j] != kGuardValue || buf[i][frames + j - 1] != kGuardValue)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+static void check_against_scalar()
+{
+    const DspKernels* scalar = dsp_kernels_find("scalar");
+    CHECK(scalar != nullptr, "no scalar kernels");
+    if (scalar == nullptr)
+        return;
+
+    // Around every vector width (4, 8, 16 floats), plus a typical block size
+    static const uint32_t kLengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 127, 511, 512, 1023 };
+
+    for (const char* name : kVariants)
+    {
+        const DspKernels* variant = dsp_kernels_find(name);
+        if (variant == nullptr)
+        {
+            std::printf("%s: not supported here, skipped\n", name);
+            continue;
+        }
+
+        int cases = 0;
+
+        for (const KernelCase& kernel : kCases)
+        {
+            for (uint32_t offset = 0; offset < 4; ++offset)
+            {
+                for (uint32_t frames : kLengths)
+                {
+                    const uint32_t seed = offset * 7919 + frames;
+
+                    BufferSet expected(offset, frames, seed);
+                    BufferSet actual(offset, frames, seed);
+
+                    const float expectedResult = kernel.run(*scalar, expected.buf, frames);
+                    const float actualResult = kernel.run(*variant, actual.buf, frames);
+
+                    CHECK(std::memcmp(&expectedResult, &actualResult, sizeof(float)) == 0,
+                          "%s %s, offset %u, %u frames: returned %g, scalar %g",
+                          name, kernel.name, offset, frames, actualResult, expectedResult);
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        CHECK(std::memcmp(expected.buf[i], actual.buf[i], sizeof(float) * frames) == 0,
+                              "%s %s, offset %u, %u frames: buffer %d differs from scalar",
+                              name, kernel.name, offset, frames, i);
+                    }
+
+                    CHECK(actual.guardsIntact(frames), "%s %s, offset %u, %u frames: wrote out of bounds",
+                          name, kernel.name, offset, frames);
+
+                    ++cases;
+                }
+            }
+        }
+
+        std::printf("%s: %d cases compared\n", name, cases);
+    }
+
+    CHECK(dsp_kernels_find("no such variant") == nullptr, "unknown variant name resolved");
+    std::printf("dispatched: %s\n", dsp_kernels().name);
+}
+
+static void benchmark()
+{
+    const uint32_t frames = 512;
+    const int blocks = 100000;
+
+    // Plain audio, as denormal arithmetic would swamp the timings.
+    // Separate in and out buffers, so values neither grow nor decay into denormals between blocks.
+    BufferSet buffers(0, frames, 1, true);
+    volatile float sink = 0.0f;
+
+    for (const KernelCase& kernel : kCases)
+    {
+        if (std::strstr(kernel.name, "in place") != nullptr)
+            continue;
+
+        double scalarNs = 0.0;
+
+        for (const char* name : kVariants)
+        {
+            const DspKernels* variant = dsp_kernels_find(name);
+            if (variant == nullptr)
+                continue;
+
+            // Re-seed accumulators, so mixStereo and multiplyAdd start from the same state for every variant
+            BufferSet fresh(0, frames, 1, true);
+            for (int i = 0; i < 4; ++i)
+                std::memcpy(buffers.buf[i], fresh.buf[i], sizeof(float) * frames);
+
+            sink = sink + kernel.run(*variant, buffers.buf, frames);
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < blocks; ++i)
+                sink = sink + kernel.run(*variant, buffers.buf, frames);
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / blocks;
+
+            if (variant == dsp_kernels_find("scalar"))
+                scalarNs = ns;
+
+            std::printf("%-15s %-7s %8.1f ns per %u frames (%.2fx scalar)\n", kernel.name, name, ns, frames,
+                        scalarNs > 0.0 ? scalarNs / ns : 1.0);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    check_against_scalar();
+
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+        benchmark();
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ *  editor_close_check.cpp - Main-thread cost of closing 1 to 64 editors, and of unloading with one stuck
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Simulates a host closing 1 to 64 editors at once, in shuffled order, the way
+ * GlfwBackendExampleUI::closeEditor() does, then idling until all are retired.
+ * Each editor's drawing thread swaps a frame every 16 ms, and only sees the stop
+ * request between frames. Every eighth editor has a slow 120 ms swap, so it
+ * misses kCloseTimeout. Checks that no close and no idle tick blocks the main
+ * thread for longer than kCloseTimeout, and that every editor is retired once.
+ *
+ * Then unloads with one drawing thread stuck in a swap for good, which must be
+ * left behind within kUnloadTimeout instead of hanging the unload.
+ *
+ * Swaps are sleeps, so no display is needed. With --benchmark, mean and worst
+ * main-thread time per close and per idle tick are printed for each count.
+ */
+
+#include "closed_editors.hpp"
+#include "monotonic_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+static const size_t kEditorCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static const std::chrono::milliseconds kFrameTime(16);
+static const std::chrono::milliseconds kSlowFrameTime(120);
+
+// Scheduling noise on a loaded machine, on top of the deadlines
+static const uint64_t kSlackNs = 30 * 1000000ull;
+
+static const uint64_t kCloseTimeoutNs =
+    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(ClosedEditorList::kCloseTimeout).count();
+static const uint64_t kUnloadTimeoutNs =
+    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(ClosedEditorList::kUnloadTimeout).count();
+
+/**
+ * Stands in for EditorSession: a stop request, an uninterruptible swap and a
+ * finished flag. A stuck editor's swap only returns once unstick() is called.
+ */
+class SimEditor : public ClosingEditor {
+public:
+    SimEditor(std::chrono::milliseconds frameTime, bool stuck) : fFrameTime(frameTime), fStuck(stuck) {}
+
+    void requestStop() { fStopRequested.store(true, std::memory_order_release); }
+    bool isStopRequested() const { return fStopRequested.load(std::memory_order_acquire); }
+
+    void swap()
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        if (fStuck)
+            fCondition.wait(lock, [this] { return !fStuck; });
+        else
+            fCondition.wait_for(lock, fFrameTime, [] { return false; });
+    }
+
+    void unstick()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fStuck = false;
+        }
+        fCondition.notify_all();
+    }
+
+    void markFinished()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fFinished = true;
+        }
+        fCondition.notify_all();
+    }
+
+    bool isFinished() const override
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        return fFinished;
+    }
+
+    bool waitFinished(std::chrono::milliseconds timeout) const override
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        return fCondition.wait_for(lock, timeout, [this] { return fFinished; });
+    }
+
+    void retire(bool keepWarm) override
+    {
+        ++fRetired;
+        fRetiredWarm = keepWarm;
+    }
+
+    int getRetired() const { return fRetired; }
+    bool wasRetiredWarm() const { return fRetiredWarm; }
+
+private:
+    const std::chrono::milliseconds fFrameTime;
+    std::atomic<bool> fStopRequested{false};
+    mutable std::mutex fMutex;
+    mutable std::condition_variable fCondition;
+    bool fStuck;
+    bool fFinished = false;
+    int fRetired = 0;
+    bool fRetiredWarm = false;
+};
+
+// Holds its own reference, like imgui_drawing_thread()
+static void sim_drawing_thread(std::shared_ptr<SimEditor> editor)
+{
+    while (!editor->isStopRequested())
+        editor->swap();
+
+    editor->markFinished();
+}
+
+struct SimOpenEditor {
+    std::shared_ptr<SimEditor> editor;
+    std::thread thread;
+};
+
+static SimOpenEditor open_editor(std::chrono::milliseconds frameTime, bool stuck = false)
+{
+    SimOpenEditor open;
+    open.editor = std::make_shared<SimEditor>(frameTime, stuck);
+    open.thread = std::thread(sim_drawing_thread, open.editor);
+    return open;
+}
+
+// GlfwBackendExampleUI::closeEditor(), minus GLFW. Returns main-thread ns spent.
+static uint64_t close_editor(SimOpenEditor &open)
+{
+    const uint64_t startNs = monotonic_now_ns();
+
+    open.editor->requestStop();
+    open.editor->waitFinished(ClosedEditorList::kCloseTimeout);
+    ClosedEditorList::instance().add(std::move(open.thread), open.editor);
+
+    return monotonic_now_ns() - startNs;
+}
+
+struct CloseTimes {
+    uint64_t closeTotalNs = 0;
+    uint64_t closeMaxNs = 0;
+    uint64_t tickMaxNs = 0;
+    int ticks = 0;
+};
+
+static CloseTimes run_closes(size_t count)
+{
+    ClosedEditorList &list = ClosedEditorList::instance();
+    std::vector<SimOpenEditor> editors;
+    std::mt19937 rng((uint32_t)count);
+    CloseTimes times;
+
+    for (size_t i = 0; i < count; ++i)
+        editors.push_back(open_editor(i % 8 == 7 ? kSlowFrameTime : kFrameTime));
+
+    // Let every thread get into its swap loop
+    std::this_thread::sleep_for(kFrameTime);
+
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    for (size_t i : order)
+    {
+        const uint64_t ns = close_editor(editors[i]);
+        times.closeTotalNs += ns;
+        times.closeMaxNs = std::max(times.closeMaxNs, ns);
+        CHECK(ns <= kCloseTimeoutNs + kSlackNs, "%zu editors: close took %.1f ms", count, (double)ns / 1e6);
+    }
+
+    // Host idle ticks, one retirement each, until late threads are done too
+    while (list.size() != 0 && times.ticks < 1000)
+    {
+        const uint64_t startNs = monotonic_now_ns();
+        list.sweep(1, true);
+        const uint64_t ns = monotonic_now_ns() - startNs;
+
+        times.tickMaxNs = std::max(times.tickMaxNs, ns);
+        ++times.ticks;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    CHECK(list.size() == 0, "%zu editors: %zu never retired", count, list.size());
+    CHECK(times.tickMaxNs <= kCloseTimeoutNs, "%zu editors: idle tick took %.1f ms", count, (double)times.tickMaxNs / 1e6);
+
+    for (const SimOpenEditor &open : editors)
+        CHECK(open.editor->getRetired() == 1 && open.editor->wasRetiredWarm(), "%zu editors: retired %d times",
+              count, open.editor->getRetired());
+
+    return times;
+}
+
+static void check_close_latency(bool print)
+{
+    for (size_t count : kEditorCounts)
+    {
+        const CloseTimes times = run_closes(count);
+
+        if (print)
+            std::printf("%2zu editors: close %6.2f ms mean, %6.2f ms worst; idle tick %5.3f ms worst, %d ticks to retire all\n",
+                        count, (double)times.closeTotalNs / count / 1e6, (double)times.closeMaxNs / 1e6,
+                        (double)times.tickMaxNs / 1e6, times.ticks);
+    }
+}
+
+static void check_unload_with_stuck_thread(bool print)
+{
+    ClosedEditorList &list = ClosedEditorList::instance();
+    std::vector<SimOpenEditor> editors;
+
+    for (int i = 0; i < 4; ++i)
+        editors.push_back(open_editor(kFrameTime, i == 2));
+    std::this_thread::sleep_for(kFrameTime);
+
+    for (SimOpenEditor &open : editors)
+        close_editor(open);
+
+    const uint64_t startNs = monotonic_now_ns();
+    const size_t leftBehind = list.shutdown(ClosedEditorList::kUnloadTimeout);
+    const uint64_t ns = monotonic_now_ns() - startNs;
+
+    CHECK(leftBehind == 1, "%zu threads left behind", leftBehind);
+    CHECK(ns <= kUnloadTimeoutNs + kSlackNs, "unload took %.1f ms", (double)ns / 1e6);
+    CHECK(list.size() == 0, "%zu editors left after unload", list.size());
+
+    for (size_t i = 0; i < editors.size(); ++i)
+    {
+        const int expected = i == 2 ? 0 : 1;
+        CHECK(editors[i].editor->getRetired() == expected && !editors[i].editor->wasRetiredWarm(),
+              "editor %zu retired %d times at unload", i, editors[i].editor->getRetired());
+    }
+
+    if (print)
+        std::printf("Unload with one stuck thread: %.1f ms\n", (double)ns / 1e6);
+
+    // The detached thread still runs on its own reference. Let it go before we exit.
+    editors[2].editor->unstick();
+    CHECK(editors[2].editor->waitFinished(std::chrono::milliseconds(1000)), "stuck thread never finished");
+}
+
+int main(int argc, char **argv)
+{
+    const bool print = argc > 1 && std::strcmp(argv[1], "--benchmark") == 0;
+
+    check_close_latency(print);
+    check_unload_with_stuck_thread(print);
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
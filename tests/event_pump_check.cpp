@@ -0,0 +1,152 @@
+/*
+ *  event_pump_check.cpp - Polls per idle tick and bookkeeping cost of EditorEventPump
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Simulates a host idling 1 to 64 editors per tick, in a different order every
+ * tick, and checks the pump polls exactly once per tick. Also with one editor
+ * stalled, which must not stop the others from being served.
+ *
+ * glfwPollEvents() is replaced by a counter, so no display is needed. Timings
+ * printed with --benchmark are therefore the pump's own main-thread overhead
+ * per tick, not GLFW's poll time, which depends on the host and windowing system.
+ */
+
+#include "event_pump.hpp"
+#include "monotonic_clock.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+// Stands in for GLFW's, see file comment
+static uint64_t polls = 0;
+
+extern "C" void glfwPollEvents(void)
+{
+    ++polls;
+}
+
+static const size_t kEditorCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+/**
+ * Subscribe `count` editors, run `ticks` host ticks idling all of them but editor `stalled`
+ * in shuffled order, unsubscribe. Returns polls made, and main-thread ns spent in pump().
+ */
+static uint64_t run_ticks(size_t count, int ticks, size_t stalled, uint64_t &pumpNs)
+{
+    EditorEventPump &pump = EditorEventPump::instance();
+    std::vector<int> editors(count);
+    std::vector<size_t> order;
+    std::mt19937 rng((uint32_t)count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        pump.subscribe(&editors[i]);
+        order.push_back(i);
+    }
+
+    polls = 0;
+    pumpNs = 0;
+
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+        const uint64_t pollsBefore = polls;
+
+        const uint64_t startNs = monotonic_now_ns();
+        for (size_t i : order)
+        {
+            if (i != stalled)
+                pump.pump(&editors[i]);
+        }
+        pumpNs += monotonic_now_ns() - startNs;
+
+        CHECK(polls - pollsBefore == 1, "%zu editors, tick %d: %llu polls", count, tick,
+              (unsigned long long)(polls - pollsBefore));
+    }
+
+    for (int &editor : editors)
+        pump.unsubscribe(&editor);
+
+    CHECK(pump.getSubscriberCount() == 0, "%zu subscribers left", pump.getSubscriberCount());
+    return polls;
+}
+
+static void check_one_poll_per_tick()
+{
+    const int ticks = 100;
+    uint64_t pumpNs;
+
+    for (size_t count : kEditorCounts)
+    {
+        CHECK(run_ticks(count, ticks, SIZE_MAX, pumpNs) == (uint64_t)ticks, "%zu editors", count);
+
+        if (count > 1)
+            CHECK(run_ticks(count, ticks, count / 2, pumpNs) == (uint64_t)ticks, "%zu editors, one stalled", count);
+    }
+
+    // Unknown editors are ignored
+    int stranger;
+    polls = 0;
+    CHECK(!EditorEventPump::instance().pump(&stranger) && polls == 0, "unsubscribed editor polled");
+}
+
+static void benchmark()
+{
+    const int ticks = 100000;
+
+    for (size_t count : kEditorCounts)
+    {
+        uint64_t pumpNs;
+        const uint64_t pumped = run_ticks(count, ticks, SIZE_MAX, pumpNs);
+
+        std::printf("%2zu editors: %.2f polls per tick (was %zu), pump overhead %7.1f ns per tick\n",
+                    count, (double)pumped / ticks, count, (double)pumpNs / ticks);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    check_one_poll_per_tick();
+
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+        benchmark();
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,799 @@
+/*
+ *  soft_rasterizer_check.cpp - Pixel comparison and throughput of SoftRasterizer
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Renders hand-made draw lists whose pixels are known exactly, and a random
+ * scene of gradients, glyph-like coverage, textures and clip rects. The random
+ * scene must come out bit-identical with and without worker threads, and
+ * match a straightforward per-pixel reference rasteriser within rounding.
+ *
+ * The random scenes are also drawn through ImGui's OpenGL2 backend, the path
+ * the plugin takes without the software renderer, into a hidden window, and
+ * read back. Without a display or framebuffer objects, that part is skipped.
+ *
+ * Then times the random scene at 1920x1080, single-threaded, threaded and GL.
+ */
+
+#include "soft_renderer.hpp"
+
+#include "backends/imgui_impl_opengl2.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+// Random scene against the reference: rounding only, on all but a few texel-border pixels
+static constexpr uint32_t kMaxChannelDiff = 4;
+static constexpr double kMaxOffRatio = 0.001;
+
+// Random scene against GL: drivers differ in interpolation precision, edge ties and scissor rounding
+static constexpr uint32_t kMaxGlChannelDiff = 8;
+static constexpr double kMaxGlOffRatio = 0.005;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+// ImDrawData::CmdLists is a plain array in older ImGui versions, an ImVector in newer ones
+static void set_draw_lists(ImDrawList **&lists, std::vector<ImDrawList *> &source)
+{
+    lists = source.data();
+}
+
+static void set_draw_lists(ImVector<ImDrawList *> &lists, std::vector<ImDrawList *> &source)
+{
+    lists.resize(0);
+    for (ImDrawList *list : source)
+        lists.push_back(list);
+}
+
+/**
+ * A frame built by hand. Every triangle gets its own draw command, so clip
+ * rects and textures can change per triangle. Indices are relative to the
+ * start of the list, as the GL2 backend does not support VtxOffset, so a new
+ * list is started before they run out.
+ */
+struct Scene {
+    std::vector<std::unique_ptr<ImDrawList>> lists;
+    std::vector<ImDrawList *> listPointers;
+    ImDrawData drawData;
+    int width, height;
+
+    Scene(int w, int h) : width(w), height(h)
+    {
+        lists.emplace_back(new ImDrawList(nullptr));
+    }
+
+    void triangle(const ImDrawVert &a, const ImDrawVert &b, const ImDrawVert &c,
+                  const ImVec4 &clip, const SoftTexture *texture)
+    {
+        if (lists.back()->VtxBuffer.Size + 3 > 65536)
+            lists.emplace_back(new ImDrawList(nullptr));
+
+        ImDrawList &list = *lists.back();
+        const ImDrawIdx first = (ImDrawIdx)list.VtxBuffer.Size;
+
+        ImDrawCmd cmd;
+        cmd.ClipRect = clip;
+        cmd.TextureId = (ImTextureID)texture;
+        cmd.VtxOffset = 0;
+        cmd.IdxOffset = (unsigned int)list.IdxBuffer.Size;
+        cmd.ElemCount = 3;
+        list.CmdBuffer.push_back(cmd);
+
+        list.VtxBuffer.push_back(a);
+        list.VtxBuffer.push_back(b);
+        list.VtxBuffer.push_back(c);
+        for (ImDrawIdx i = 0; i < 3; ++i)
+            list.IdxBuffer.push_back((ImDrawIdx)(first + i));
+    }
+
+    const ImDrawData *finish()
+    {
+        listPointers.clear();
+        for (auto &list : lists)
+            listPointers.push_back(list.get());
+
+        drawData.Valid = true;
+        drawData.CmdListsCount = (int)listPointers.size();
+        set_draw_lists(drawData.CmdLists, listPointers);
+        drawData.DisplayPos = ImVec2(0.0f, 0.0f);
+        drawData.DisplaySize = ImVec2((float)width, (float)height);
+        drawData.FramebufferScale = ImVec2(1.0f, 1.0f);
+        return &drawData;
+    }
+};
+
+static ImDrawVert vertex(float x, float y, ImU32 col, float u = 0.0f, float v = 0.0f)
+{
+    ImDrawVert vert;
+    vert.pos = ImVec2(x, y);
+    vert.uv = ImVec2(u, v);
+    vert.col = col;
+    return vert;
+}
+
+static std::vector<uint32_t> render(SoftRasterizer &rasterizer, const ImDrawData *drawData, int width, int height, const ImVec4 &clear)
+{
+    std::vector<uint32_t> pixels((size_t)width * height);
+    rasterizer.render(drawData, pixels.data(), width, height, width, clear);
+    return pixels;
+}
+
+// BGRA framebuffer pixel from ImGui's colour bytes
+static uint32_t bgra(uint32_t r, uint32_t g, uint32_t b)
+{
+    return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+static uint32_t channel(uint32_t pixel, int shift)
+{
+    return (pixel >> shift) & 0xff;
+}
+
+// Same rounding as SoftRasterizer
+static uint32_t clear_pixel(const ImVec4 &clear)
+{
+    return bgra((uint32_t)(clear.x * clear.w * 255.0f + 0.5f),
+                (uint32_t)(clear.y * clear.w * 255.0f + 0.5f),
+                (uint32_t)(clear.z * clear.w * 255.0f + 0.5f));
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// GL: the same draw data through ImGui's OpenGL2 backend, into a framebuffer object of a hidden window
+
+// Not in GL 1.1 headers
+static constexpr GLenum kGlFramebuffer = 0x8D40;
+static constexpr GLenum kGlColorAttachment0 = 0x8CE0;
+static constexpr GLenum kGlFramebufferComplete = 0x8CD5;
+static constexpr GLenum kGlClampToEdge = 0x812F;
+static constexpr GLenum kGlBgra = 0x80E1;
+
+struct GLTarget {
+    GLFWwindow *window = nullptr;
+    ImGuiContext *imgui = nullptr;
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    int width = 0, height = 0;
+
+    // Scene textures as uploaded, and the white texture standing in for untextured commands
+    std::vector<std::pair<const SoftTexture *, GLuint>> textures;
+
+    void (*genFramebuffers)(GLsizei, GLuint *) = nullptr;
+    void (*deleteFramebuffers)(GLsizei, const GLuint *) = nullptr;
+    void (*bindFramebuffer)(GLenum, GLuint) = nullptr;
+    void (*framebufferTexture2D)(GLenum, GLenum, GLenum, GLuint, GLint) = nullptr;
+    GLenum (*checkFramebufferStatus)(GLenum) = nullptr;
+};
+
+template <typename Function>
+static bool load_gl_function(Function &function, const char *name)
+{
+    function = reinterpret_cast<Function>(glfwGetProcAddress(name));
+    return function != nullptr;
+}
+
+static void gl_close(GLTarget &gl)
+{
+    if (gl.window == nullptr)
+        return;
+
+    for (auto &texture : gl.textures)
+        glDeleteTextures(1, &texture.second);
+    gl.textures.clear();
+
+    if (gl.framebuffer != 0)
+        gl.deleteFramebuffers(1, &gl.framebuffer);
+    if (gl.colorBuffer != 0)
+        glDeleteTextures(1, &gl.colorBuffer);
+    gl.framebuffer = gl.colorBuffer = 0;
+
+    if (gl.imgui != nullptr)
+    {
+        ImGui_ImplOpenGL2_Shutdown();
+        ImGui::DestroyContext(gl.imgui);
+        gl.imgui = nullptr;
+    }
+
+    glfwDestroyWindow(gl.window);
+    gl.window = nullptr;
+    glfwTerminate();
+}
+
+/**
+ * Open a hidden window rendering into a width x height framebuffer object.
+ * Returns false, with a message, if this machine can't.
+ */
+static bool gl_open(GLTarget &gl, int width, int height)
+{
+    if (!glfwInit())
+    {
+        std::printf("No display, GL comparison skipped\n");
+        return false;
+    }
+
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    gl.window = glfwCreateWindow(64, 64, "soft_rasterizer_check", nullptr, nullptr);
+    if (gl.window == nullptr)
+    {
+        std::printf("No GL context, GL comparison skipped\n");
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(gl.window);
+
+    if (!load_gl_function(gl.genFramebuffers, "glGenFramebuffers") ||
+        !load_gl_function(gl.deleteFramebuffers, "glDeleteFramebuffers") ||
+        !load_gl_function(gl.bindFramebuffer, "glBindFramebuffer") ||
+        !load_gl_function(gl.framebufferTexture2D, "glFramebufferTexture2D") ||
+        !load_gl_function(gl.checkFramebufferStatus, "glCheckFramebufferStatus"))
+    {
+        std::printf("No framebuffer objects on %s, GL comparison skipped\n", (const char *)glGetString(GL_RENDERER));
+        glfwDestroyWindow(gl.window);
+        gl.window = nullptr;
+        glfwTerminate();
+        return false;
+    }
+
+    gl.width = width;
+    gl.height = height;
+
+    glGenTextures(1, &gl.colorBuffer);
+    glBindTexture(GL_TEXTURE_2D, gl.colorBuffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    gl.genFramebuffers(1, &gl.framebuffer);
+    gl.bindFramebuffer(kGlFramebuffer, gl.framebuffer);
+    gl.framebufferTexture2D(kGlFramebuffer, kGlColorAttachment0, GL_TEXTURE_2D, gl.colorBuffer, 0);
+
+    gl.imgui = ImGui::CreateContext();
+    ImGui_ImplOpenGL2_Init();
+
+    if (gl.checkFramebufferStatus(kGlFramebuffer) != kGlFramebufferComplete)
+    {
+        std::printf("Incomplete framebuffer on %s, GL comparison skipped\n", (const char *)glGetString(GL_RENDERER));
+        gl_close(gl);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Nearest and clamped, the way SoftRasterizer samples. The plugin filters its font
+ * atlas linearly, which makes no difference for glyphs drawn at texel size, but
+ * would for the random UVs of these scenes.
+ */
+static GLuint gl_texture(GLTarget &gl, const SoftTexture *tex)
+{
+    for (const auto &texture : gl.textures)
+    {
+        if (texture.first == tex)
+            return texture.second;
+    }
+
+    static const uint8_t white[4] = { 255, 255, 255, 255 };
+
+    GLuint name;
+    glGenTextures(1, &name);
+    glBindTexture(GL_TEXTURE_2D, name);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, kGlClampToEdge);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, kGlClampToEdge);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (tex != nullptr)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex->pixels);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+    gl.textures.emplace_back(tex, name);
+    return name;
+}
+
+// Draw the scene as the plugin's GL path would, with the scene's textures swapped for GL ones
+static void gl_draw(GLTarget &gl, Scene &scene, const ImVec4 &clear)
+{
+    const ImDrawData *drawData = scene.finish();
+
+    std::vector<ImTextureID> softTextures;
+    for (auto &list : scene.lists)
+    {
+        for (ImDrawCmd &cmd : list->CmdBuffer)
+        {
+            softTextures.push_back(cmd.TextureId);
+            cmd.TextureId = (ImTextureID)(intptr_t)gl_texture(gl, (const SoftTexture *)cmd.TextureId);
+        }
+    }
+
+    gl.bindFramebuffer(kGlFramebuffer, gl.framebuffer);
+    glViewport(0, 0, gl.width, gl.height);
+    glClearColor(clear.x * clear.w, clear.y * clear.w, clear.z * clear.w, clear.w);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ImGui_ImplOpenGL2_RenderDrawData(const_cast<ImDrawData *>(drawData));
+
+    size_t i = 0;
+    for (auto &list : scene.lists)
+    {
+        for (ImDrawCmd &cmd : list->CmdBuffer)
+            cmd.TextureId = softTextures[i++];
+    }
+}
+
+// Top row first, like SoftRasterizer's framebuffer
+static std::vector<uint32_t> gl_read(GLTarget &gl)
+{
+    std::vector<uint32_t> pixels((size_t)gl.width * gl.height);
+
+    gl.bindFramebuffer(kGlFramebuffer, gl.framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, gl.width, gl.height, kGlBgra, GL_UNSIGNED_BYTE, pixels.data());
+
+    for (int y = 0; y < gl.height / 2; ++y)
+        std::swap_ranges(pixels.begin() + (size_t)y * gl.width, pixels.begin() + (size_t)(y + 1) * gl.width,
+                         pixels.begin() + (size_t)(gl.height - 1 - y) * gl.width);
+    return pixels;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// Reference: evaluate every pixel center against every triangle, in floating point
+
+static const uint8_t *reference_texel(const SoftTexture *tex, float u, float v)
+{
+    const int x = std::min(std::max((int)(u * (float)tex->width), 0), tex->width - 1);
+    const int y = std::min(std::max((int)(v * (float)tex->height), 0), tex->height - 1);
+    return tex->pixels + ((size_t)y * tex->width + x) * 4;
+}
+
+static std::vector<uint32_t> render_reference(const ImDrawData *drawData, int width, int height, uint32_t clearPixel)
+{
+    std::vector<uint32_t> pixels((size_t)width * height, clearPixel);
+
+    for (int n = 0; n < drawData->CmdListsCount; ++n)
+    {
+        const ImDrawList *list = drawData->CmdLists[n];
+
+        for (const ImDrawCmd &cmd : list->CmdBuffer)
+        {
+            const SoftTexture *tex = (const SoftTexture *)cmd.GetTexID();
+            const ImDrawVert *vtx = list->VtxBuffer.Data + cmd.VtxOffset;
+            const ImDrawIdx *idx = list->IdxBuffer.Data + cmd.IdxOffset;
+
+            for (unsigned int i = 0; i + 2 < cmd.ElemCount; i += 3)
+            {
+                const ImDrawVert *v[3] = { &vtx[idx[i]], &vtx[idx[i + 1]], &vtx[idx[i + 2]] };
+                const double area = ((double)v[1]->pos.x - v[0]->pos.x) * ((double)v[2]->pos.y - v[0]->pos.y) -
+                                    ((double)v[2]->pos.x - v[0]->pos.x) * ((double)v[1]->pos.y - v[0]->pos.y);
+                if (std::fabs(area) < 1e-6)
+                    continue;
+
+                // Clip rect, narrowed to the bounding box to keep this fast enough
+                const float minX = std::min(v[0]->pos.x, std::min(v[1]->pos.x, v[2]->pos.x));
+                const float maxX = std::max(v[0]->pos.x, std::max(v[1]->pos.x, v[2]->pos.x));
+                const float minY = std::min(v[0]->pos.y, std::min(v[1]->pos.y, v[2]->pos.y));
+                const float maxY = std::max(v[0]->pos.y, std::max(v[1]->pos.y, v[2]->pos.y));
+
+                const int x0 = std::max({ 0, (int)cmd.ClipRect.x, (int)std::floor(minX) });
+                const int y0 = std::max({ 0, (int)cmd.ClipRect.y, (int)std::floor(minY) });
+                const int x1 = std::min({ width, (int)cmd.ClipRect.z, (int)std::ceil(maxX) });
+                const int y1 = std::min({ height, (int)cmd.ClipRect.w, (int)std::ceil(maxY) });
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    for (int x = x0; x < x1; ++x)
+                    {
+                        const double px = x + 0.5, py = y + 0.5;
+                        double w[3];
+                        bool inside = true;
+
+                        for (int k = 0; k < 3 && inside; ++k)
+                        {
+                            const ImDrawVert *a = v[(k + 1) % 3], *b = v[(k + 2) % 3];
+                            w[k] = (((double)b->pos.x - a->pos.x) * (py - a->pos.y) -
+                                    ((double)b->pos.y - a->pos.y) * (px - a->pos.x)) / area;
+                            inside = w[k] >= 0.0;
+                        }
+                        if (!inside)
+                            continue;
+
+                        double attr[6] = {};
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            attr[0] += w[k] * v[k]->uv.x;
+                            attr[1] += w[k] * v[k]->uv.y;
+                            attr[2] += w[k] * ((v[k]->col >> IM_COL32_R_SHIFT) & 0xff);
+                            attr[3] += w[k] * ((v[k]->col >> IM_COL32_G_SHIFT) & 0xff);
+                            attr[4] += w[k] * ((v[k]->col >> IM_COL32_B_SHIFT) & 0xff);
+                            attr[5] += w[k] * ((v[k]->col >> IM_COL32_A_SHIFT) & 0xff);
+                        }
+
+                        double rgba[4] = { attr[2], attr[3], attr[4], attr[5] };
+                        if (tex != nullptr)
+                        {
+                            const uint8_t *texel = reference_texel(tex, (float)attr[0], (float)attr[1]);
+                            for (int c = 0; c < 4; ++c)
+                                rgba[c] = rgba[c] * texel[c] / 255.0;
+                        }
+
+                        uint32_t &dst = pixels[(size_t)y * width + x];
+                        const double alpha = rgba[3] / 255.0;
+                        const double out[3] = {
+                            rgba[0] * alpha + channel(dst, 16) * (1.0 - alpha),
+                            rgba[1] * alpha + channel(dst, 8) * (1.0 - alpha),
+                            rgba[2] * alpha + channel(dst, 0) * (1.0 - alpha),
+                        };
+                        dst = bgra((uint32_t)std::lround(out[0]), (uint32_t)std::lround(out[1]), (uint32_t)std::lround(out[2]));
+                    }
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+static void check_opaque_rect()
+{
+    Scene scene(64, 48);
+    const ImVec4 noClip(0.0f, 0.0f, 64.0f, 48.0f);
+    const ImU32 red = IM_COL32(255, 0, 0, 255);
+
+    // A quad with one triangle of each winding, as ImGui emits them
+    scene.triangle(vertex(8, 8, red), vertex(40, 8, red), vertex(40, 24, red), noClip, nullptr);
+    scene.triangle(vertex(8, 8, red), vertex(8, 24, red), vertex(40, 24, red), noClip, nullptr);
+
+    SoftRasterizer rasterizer(1);
+    const std::vector<uint32_t> pixels = render(rasterizer, scene.finish(), 64, 48, ImVec4(0, 0, 0, 1));
+
+    int wrong = 0;
+    for (int y = 0; y < 48; ++y)
+        for (int x = 0; x < 64; ++x)
+        {
+            const bool inside = x >= 8 && x < 40 && y >= 8 && y < 24;
+            wrong += pixels[(size_t)y * 64 + x] != (inside ? bgra(255, 0, 0) : bgra(0, 0, 0));
+        }
+
+    CHECK(wrong == 0, "opaque rect: %d wrong pixels", wrong);
+}
+
+static void check_translucent_diagonal()
+{
+    Scene scene(32, 32);
+    const ImVec4 noClip(0.0f, 0.0f, 32.0f, 32.0f);
+    const ImU32 white = IM_COL32(255, 255, 255, 128);
+
+    scene.triangle(vertex(4, 4, white), vertex(28, 4, white), vertex(28, 28, white), noClip, nullptr);
+    scene.triangle(vertex(4, 4, white), vertex(28, 28, white), vertex(4, 28, white), noClip, nullptr);
+
+    SoftRasterizer rasterizer(1);
+    const std::vector<uint32_t> pixels = render(rasterizer, scene.finish(), 32, 32, ImVec4(0, 0, 0, 1));
+
+    // (255 * 128 + 127) / 255, blended exactly once on the shared edge too
+    const uint32_t expected = bgra(128, 128, 128);
+
+    int wrong = 0;
+    for (int y = 4; y < 28; ++y)
+        for (int x = 4; x < 28; ++x)
+            wrong += pixels[(size_t)y * 32 + x] != expected;
+
+    CHECK(wrong == 0, "translucent quad: %d pixels not blended exactly once", wrong);
+}
+
+static void check_clip_and_coverage()
+{
+    // Alpha-only texture, like the font atlas: a checkerboard of 0 and 255
+    std::vector<uint8_t> texels(8 * 8 * 4);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+        {
+            uint8_t *texel = &texels[((size_t)y * 8 + x) * 4];
+            texel[0] = texel[1] = texel[2] = 255;
+            texel[3] = ((x + y) & 1) ? 255 : 0;
+        }
+
+    SoftTexture tex;
+    tex.width = 8;
+    tex.height = 8;
+    tex.pixels = texels.data();
+    tex.whiteRgb = true;
+
+    Scene scene(16, 16);
+    const ImU32 green = IM_COL32(0, 255, 0, 255);
+    const ImVec4 clip(0.0f, 0.0f, 16.0f, 12.0f);
+
+    // One texel per pixel over 8x8 pixels, clipped at row 12
+    scene.triangle(vertex(0, 0, green, 0, 0), vertex(16, 0, green, 1, 0), vertex(16, 16, green, 1, 1), clip, &tex);
+    scene.triangle(vertex(0, 0, green, 0, 0), vertex(16, 16, green, 1, 1), vertex(0, 16, green, 0, 1), clip, &tex);
+
+    SoftRasterizer rasterizer(1);
+    const std::vector<uint32_t> pixels = render(rasterizer, scene.finish(), 16, 16, ImVec4(0, 0, 0, 1));
+
+    int wrong = 0;
+    for (int y = 0; y < 16; ++y)
+        for (int x = 0; x < 16; ++x)
+        {
+            const bool covered = y < 12 && (((x / 2) + (y / 2)) & 1);
+            wrong += pixels[(size_t)y * 16 + x] != (covered ? bgra(0, 255, 0) : bgra(0, 0, 0));
+        }
+
+    CHECK(wrong == 0, "clipped coverage: %d wrong pixels", wrong);
+}
+
+/**
+ * Random triangles of every kind the rasteriser has a path for: flat, flat
+ * textured, coverage, gradients and coloured textures, under random clip rects.
+ */
+static void build_random_scene(Scene &scene, uint32_t seed, int triangleCount, float largeRatio,
+                               const SoftTexture *fontTex, const SoftTexture *colorTex)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> coordX(-20.0f, (float)scene.width + 20.0f);
+    std::uniform_real_distribution<float> coordY(-20.0f, (float)scene.height + 20.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> kind(0, 4);
+
+    auto color = [&](bool opaque) {
+        return IM_COL32(byte(rng), byte(rng), byte(rng), opaque ? 255 : byte(rng));
+    };
+
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        // Mostly small triangles, like ImGui's glyphs and frames, some as large as window backgrounds
+        const float cx = coordX(rng), cy = coordY(rng);
+        const float size = unit(rng) < largeRatio ? 400.0f : 24.0f;
+        auto point = [&] { return ImVec2(cx + (unit(rng) - 0.5f) * size, cy + (unit(rng) - 0.5f) * size); };
+        const ImVec2 p0 = point(), p1 = point(), p2 = point();
+
+        ImVec4 clip(0.0f, 0.0f, (float)scene.width, (float)scene.height);
+        if (unit(rng) < 0.3f)
+        {
+            const float x0 = coordX(rng), y0 = coordY(rng);
+            clip = ImVec4(x0, y0, x0 + unit(rng) * 300.0f, y0 + unit(rng) * 300.0f);
+        }
+
+        switch (kind(rng))
+        {
+        case 0:     // Flat
+        {
+            const ImU32 col = color(unit(rng) < 0.5f);
+            scene.triangle(vertex(p0.x, p0.y, col), vertex(p1.x, p1.y, col), vertex(p2.x, p2.y, col), clip, nullptr);
+            break;
+        }
+        case 1:     // Flat, sampling the atlas' white pixel
+        {
+            const ImU32 col = color(false);
+            scene.triangle(vertex(p0.x, p0.y, col, 0.01f, 0.01f), vertex(p1.x, p1.y, col, 0.01f, 0.01f),
+                           vertex(p2.x, p2.y, col, 0.01f, 0.01f), clip, fontTex);
+            break;
+        }
+        case 2:     // Glyph-like coverage
+        {
+            const ImU32 col = color(false);
+            scene.triangle(vertex(p0.x, p0.y, col, unit(rng), unit(rng)), vertex(p1.x, p1.y, col, unit(rng), unit(rng)),
+                           vertex(p2.x, p2.y, col, unit(rng), unit(rng)), clip, fontTex);
+            break;
+        }
+        case 3:     // Gradient, like anti-aliased fringes
+            scene.triangle(vertex(p0.x, p0.y, color(false)), vertex(p1.x, p1.y, color(false)),
+                           vertex(p2.x, p2.y, color(false)), clip, nullptr);
+            break;
+        default:    // Coloured texture with vertex colours
+            scene.triangle(vertex(p0.x, p0.y, color(false), unit(rng), unit(rng)),
+                           vertex(p1.x, p1.y, color(false), unit(rng), unit(rng)),
+                           vertex(p2.x, p2.y, color(false), unit(rng), unit(rng)), clip, colorTex);
+            break;
+        }
+    }
+}
+
+static void make_textures(std::vector<uint8_t> &fontTexels, SoftTexture &fontTex,
+                          std::vector<uint8_t> &colorTexels, SoftTexture &colorTex)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    fontTexels.assign(64 * 64 * 4, 255);
+    for (size_t i = 0; i < 64 * 64; ++i)
+        fontTexels[i * 4 + 3] = (uint8_t)(i == 0 ? 255 : byte(rng));
+    fontTex.width = 64;
+    fontTex.height = 64;
+    fontTex.pixels = fontTexels.data();
+    fontTex.whiteRgb = true;
+
+    colorTexels.resize(32 * 32 * 4);
+    for (uint8_t &texel : colorTexels)
+        texel = (uint8_t)byte(rng);
+    colorTex.width = 32;
+    colorTex.height = 32;
+    colorTex.pixels = colorTexels.data();
+    colorTex.whiteRgb = false;
+}
+
+// Pixels with a colour channel more than maxChannelDiff apart. maxDiff gets the largest difference of the others.
+static size_t count_off_pixels(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b,
+                               uint32_t maxChannelDiff, uint32_t &maxDiff)
+{
+    size_t offPixels = 0;
+    maxDiff = 0;
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        uint32_t diff = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+            diff = std::max(diff, (uint32_t)std::abs((int)channel(a[i], shift) - (int)channel(b[i], shift)));
+
+        if (diff > maxChannelDiff)
+            ++offPixels;
+        else
+            maxDiff = std::max(maxDiff, diff);
+    }
+
+    return offPixels;
+}
+
+static void check_random_scene()
+{
+    std::vector<uint8_t> fontTexels, colorTexels;
+    SoftTexture fontTex, colorTex;
+    make_textures(fontTexels, fontTex, colorTexels, colorTex);
+
+    const int width = 640, height = 400;
+    const ImVec4 clear(0.45f, 0.55f, 0.60f, 1.00f);
+
+    GLTarget gl;
+    const bool haveGl = gl_open(gl, width, height);
+    if (haveGl)
+        std::printf("Comparing against GL on %s\n", (const char *)glGetString(GL_RENDERER));
+
+    for (uint32_t seed = 1; seed <= 8; ++seed)
+    {
+        Scene scene(width, height);
+        build_random_scene(scene, seed, 3000, 0.1f, &fontTex, &colorTex);
+        const ImDrawData *drawData = scene.finish();
+
+        SoftRasterizer single(1);
+        SoftRasterizer threaded(4);
+        threaded.startWorkers();
+
+        const std::vector<uint32_t> a = render(single, drawData, width, height, clear);
+        const std::vector<uint32_t> b = render(threaded, drawData, width, height, clear);
+
+        size_t differentThreaded = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            differentThreaded += a[i] != b[i];
+        CHECK(differentThreaded == 0, "seed %u: %zu pixels differ between 1 and 4 threads", seed, differentThreaded);
+
+        // Reference blends in floating point and samples textures at exact positions.
+        // Pixels whose texel lookup lands on the other side of a texel border may differ a lot.
+        const std::vector<uint32_t> reference = render_reference(drawData, width, height, clear_pixel(clear));
+
+        uint32_t maxDiff;
+        double offRatio = (double)count_off_pixels(a, reference, kMaxChannelDiff, maxDiff) / (double)a.size();
+        std::printf("seed %u: %.3f%% of pixels off the reference, others within %u\n", seed, offRatio * 100.0, maxDiff);
+        CHECK(offRatio <= kMaxOffRatio, "seed %u: %.3f%% of pixels differ from the reference by more than %u",
+              seed, offRatio * 100.0, kMaxChannelDiff);
+
+        if (!haveGl)
+            continue;
+
+        gl_draw(gl, scene, clear);
+        const std::vector<uint32_t> glPixels = gl_read(gl);
+
+        offRatio = (double)count_off_pixels(a, glPixels, kMaxGlChannelDiff, maxDiff) / (double)a.size();
+        std::printf("seed %u: %.3f%% of pixels off GL, others within %u\n", seed, offRatio * 100.0, maxDiff);
+        CHECK(offRatio <= kMaxGlOffRatio, "seed %u: %.3f%% of pixels differ from GL by more than %u",
+              seed, offRatio * 100.0, kMaxGlChannelDiff);
+    }
+
+    gl_close(gl);
+}
+
+static void benchmark()
+{
+    std::vector<uint8_t> fontTexels, colorTexels;
+    SoftTexture fontTex, colorTex;
+    make_textures(fontTexels, fontTex, colorTexels, colorTex);
+
+    const int width = 1920, height = 1080;
+    const ImVec4 clear(0.45f, 0.55f, 0.60f, 1.00f);
+
+    // Roughly the triangle count of a busy editor frame, with a hundred large ones
+    Scene scene(width, height);
+    build_random_scene(scene, 1234, 20000, 0.005f, &fontTex, &colorTex);
+    const ImDrawData *drawData = scene.finish();
+
+    std::vector<uint32_t> pixels((size_t)width * height);
+
+    for (unsigned threads : { 1u, 0u })
+    {
+        SoftRasterizer rasterizer(threads);
+        rasterizer.startWorkers();
+
+        // Warm up caches and threads
+        rasterizer.render(drawData, pixels.data(), width, height, width, clear);
+
+        const int frames = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i)
+            rasterizer.render(drawData, pixels.data(), width, height, width, clear);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        std::printf("%dx%d, 20000 triangles, %s: %.2f ms per frame (%.1f Mpixel/s)\n", width, height,
+                    threads == 1 ? "1 thread" : "default threads", ms, (double)width * height / ms / 1000.0);
+    }
+
+    // GL is timed until glFinish(), when its pixels are done like SoftRasterizer's. Presenting is left out of both.
+    GLTarget gl;
+    if (!gl_open(gl, width, height))
+        return;
+
+    gl_draw(gl, scene, clear);
+    glFinish();
+
+    const int frames = 20;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i)
+    {
+        gl_draw(gl, scene, clear);
+        glFinish();
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    std::printf("%dx%d, 20000 triangles, GL on %s: %.2f ms per frame (%.1f Mpixel/s)\n", width, height,
+                (const char *)glGetString(GL_RENDERER), ms, (double)width * height / ms / 1000.0);
+    gl_close(gl);
+}
+
+int main(int argc, char **argv)
+{
+    check_opaque_rect();
+    check_translucent_diagonal();
+    check_clip_and_coverage();
+    check_random_scene();
+
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+        benchmark();
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
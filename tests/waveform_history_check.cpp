@@ -0,0 +1,118 @@
+/*
+ *  waveform_history_check.cpp - WaveformHistory sized to its columns against one keeping every level whole
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * A history keeping only the latest entries of its finer levels, see
+ * waveform_history.hpp, must answer every query of up to getMaxColumns()
+ * columns exactly like one keeping all of them. Appends come in host-sized
+ * blocks and in blocks far longer than the kept entries. Queries go at every
+ * zoom from a few samples to the whole history, and at the widest spans each
+ * level is read for.
+ */
+
+#include "waveform_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+static void check_against_whole(uint32_t capacityLog4, uint32_t maxColumns)
+{
+    WaveformHistory history(capacityLog4, maxColumns);
+    WaveformHistory whole(capacityLog4, UINT32_MAX);
+
+    CHECK(history.getCapacity() == whole.getCapacity(), "capacity %llu, whole %llu",
+          (unsigned long long)history.getCapacity(), (unsigned long long)whole.getCapacity());
+
+    std::mt19937 rng(capacityLog4 * 31 + maxColumns);
+    std::uniform_real_distribution<float> amplitude(0.0f, 1.0f);
+    std::vector<float> block;
+    std::vector<float> mins(maxColumns + 1), maxs(maxColumns + 1), wholeMins(maxColumns), wholeMaxs(maxColumns);
+    uint64_t written = 0;
+    int mismatches = 0;
+
+    for (int round = 0; round < 100; ++round)
+    {
+        const uint32_t count = round % 10 == 9 ? (uint32_t)(rng() % (whole.getCapacity() * 2)) : rng() % 2048;
+        block.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            block[i] = std::sin((float)(written + i) * 0.001f) * amplitude(rng);
+
+        history.append(block.data(), count);
+        whole.append(block.data(), count);
+        written += count;
+
+        for (int query = 0; query < 40; ++query)
+        {
+            uint32_t columns = 2 + rng() % (maxColumns - 1);
+            uint64_t span = (uint64_t)std::pow(10.0, (double)(rng() % 1000) / 1000.0 * std::log10((double)whole.getCapacity()));
+
+            // Widest, and just short of the next coarser level: the most entries a level is read for
+            if (query < 20)
+            {
+                columns = maxColumns;
+                span = std::min(((uint64_t)columns << (2 * (query / 2 + 1))) - (query % 2), whole.getCapacity());
+            }
+
+            const uint32_t first = history.query(span, columns, mins.data(), maxs.data());
+            const uint32_t wholeFirst = whole.query(span, columns, wholeMins.data(), wholeMaxs.data());
+
+            bool same = first == wholeFirst;
+            for (uint32_t column = 0; same && column < columns; ++column)
+                same = mins[column] == wholeMins[column] && maxs[column] == wholeMaxs[column];
+
+            if (!same && ++mismatches <= 5)
+                CHECK(false, "4^%u samples, %u columns max: span %llu in %u columns differs",
+                      capacityLog4, maxColumns, (unsigned long long)span, columns);
+        }
+    }
+
+    // Wider than sized for is left out
+    const uint32_t first = history.query(history.getCapacity(), maxColumns + 1, mins.data(), maxs.data());
+    CHECK(first == maxColumns + 1, "%u columns filled from %u", maxColumns + 1, first);
+}
+
+int main()
+{
+    check_against_whole(6, 7);
+    check_against_whole(8, 64);
+    check_against_whole(9, 1000);
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ *  window_pool_check.cpp - EditorWindowPool bookkeeping, ImGui context reset, warm vs cold editor open
+ *
+ *  Copyright (c) 2023 AnClark Liu
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/**
+ * Pool bookkeeping is checked on fake windows, and editor_imgui_reset() on an
+ * ImGui context with fake backends, so neither needs a display.
+ *
+ * With --benchmark, and a display, also times opening an editor up to its first
+ * frame, as the drawing thread does it:
+ *
+ *     cold         new window and GL context, ImGui context, backends, font atlas and texture
+ *     warm window  pooled window and font atlas, new ImGui context and backends
+ *     warm         pooled window and ImGui context, reset by editor_imgui_reset()
+ *
+ * Host window reparenting and vsync are left out, they cost the same either way.
+ */
+
+#include "window_pool.hpp"
+#include "monotonic_clock.hpp"
+
+#include "imgui_internal.h"
+#include "backends/imgui_impl_glfw.h"
+#include "backends/imgui_impl_opengl2.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                           \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            std::printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                   \
+            std::printf("\n");                          \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+static GLFWwindow *fake_window(uintptr_t i)
+{
+    return reinterpret_cast<GLFWwindow *>(i * 0x1000);
+}
+
+static void check_pool_bookkeeping()
+{
+    EditorWindowPool &pool = EditorWindowPool::instance();
+    const uint64_t startMs = monotonic_now_ns() / 1000000;
+
+    for (uintptr_t i = 1; i <= EditorWindowPool::kCapacity; ++i)
+    {
+        PooledEditorWindow entry;
+        entry.window = fake_window(i);
+        CHECK(pool.release(entry), "window %u not parked", (unsigned)i);
+    }
+
+    PooledEditorWindow extra;
+    extra.window = fake_window(EditorWindowPool::kCapacity + 1);
+    CHECK(!pool.release(extra), "pool grew past its capacity");
+    CHECK(pool.size() == EditorWindowPool::kCapacity, "%zu windows parked", pool.size());
+
+    // Nothing is old enough to expire yet
+    CHECK(pool.takeExpired().empty(), "fresh windows expired");
+
+    // Most recent first
+    PooledEditorWindow entry;
+    CHECK(pool.acquire(entry) && entry.window == fake_window(EditorWindowPool::kCapacity), "not the most recent window");
+    CHECK(entry.releasedAtMs >= startMs, "release time %llu before %llu",
+          (unsigned long long)entry.releasedAtMs, (unsigned long long)startMs);
+
+    const std::vector<PooledEditorWindow> all = pool.takeAll();
+    CHECK(all.size() == EditorWindowPool::kCapacity - 1, "%zu windows taken", all.size());
+    CHECK(pool.size() == 0 && !pool.acquire(entry), "pool not empty");
+}
+
+// One frame with a window, a popup, some storage, focus and held input. What a closing editor leaves behind.
+static void dirty_frame()
+{
+    ImGuiIO &io = ImGui::GetIO();
+    io.AddMousePosEvent(100.0f, 100.0f);
+    io.AddMouseButtonEvent(0, true);
+    io.AddKeyEvent(ImGuiKey_A, true);
+
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(50.0f, 50.0f));
+    ImGui::Begin("Dear ImGui Demo");
+    ImGui::GetStateStorage()->SetInt(ImGui::GetID("storage"), 42);
+    ImGui::OpenPopup("popup");
+    if (ImGui::BeginPopup("popup"))
+        ImGui::EndPopup();
+    ImGui::End();
+    ImGui::Render();
+
+    ImGui::GetStyle().Alpha = 0.5f;
+}
+
+static void check_imgui_reset()
+{
+    ImFontAtlas *atlas = IM_NEW(ImFontAtlas)();
+    unsigned char *pixels;
+    int width, height;
+    atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    atlas->SetTexID((ImTextureID)(intptr_t)1);
+
+    ImGuiContext *context = ImGui::CreateContext(atlas);
+    ImGui::SetCurrentContext(context);
+
+    // Stand-ins for the backends, which must survive the reset
+    int platformBackend, rendererBackend;
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(640.0f, 480.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.BackendPlatformUserData = &platformBackend;
+    io.BackendRendererUserData = &rendererBackend;
+
+    for (int frame = 0; frame < 3; ++frame)
+        dirty_frame();
+    CHECK(ImGui::FindWindowByName("Dear ImGui Demo") != nullptr, "no window to reset");
+
+    editor_imgui_reset(context);
+
+    const ImGuiContext &g = *context;
+    CHECK(g.Windows.Size == 0 && ImGui::FindWindowByName("Dear ImGui Demo") == nullptr,
+          "%d windows left after reset", g.Windows.Size);
+    CHECK(g.OpenPopupStack.Size == 0, "%d popups left open", g.OpenPopupStack.Size);
+    CHECK(g.NavWindow == nullptr && g.ActiveId == 0, "focus or active item left");
+    CHECK(g.Style.Alpha == 1.0f, "style alpha %f left", g.Style.Alpha);
+    CHECK(io.Fonts == atlas && io.Fonts->IsBuilt(), "font atlas lost");
+    CHECK(io.BackendPlatformUserData == &platformBackend && io.BackendRendererUserData == &rendererBackend,
+          "backends lost");
+
+    // Next editor starts with nothing held, and a window where it would open for the first time
+    ImGui::NewFrame();
+    CHECK(!ImGui::IsMouseDown(0) && !ImGui::IsKeyDown(ImGuiKey_A), "input held over reset");
+    ImGui::Begin("Dear ImGui Demo");
+    CHECK(ImGui::GetStateStorage()->GetInt(ImGui::GetID("storage"), 0) == 0, "storage left after reset");
+    CHECK(ImGui::GetWindowPos().x != 50.0f, "window position left after reset");
+    ImGui::End();
+    ImGui::Render();
+    CHECK(ImGui::GetDrawData() != nullptr && ImGui::GetDrawData()->Valid, "no frame after reset");
+
+    io.BackendPlatformUserData = nullptr;
+    io.BackendRendererUserData = nullptr;
+    ImGui::DestroyContext(context);
+    IM_DELETE(atlas);
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Benchmark, with a display.
+
+struct Editor {
+    GLFWwindow *window = nullptr;
+    ImGuiContext *context = nullptr;
+    ImFontAtlas *atlas = nullptr;
+};
+
+static const int kEditorWidth = 640;
+static const int kEditorHeight = 480;
+
+static void first_frame()
+{
+    ImGui_ImplOpenGL2_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+    ImGui::ShowDemoWindow();
+    ImGui::Render();
+
+    glViewport(0, 0, kEditorWidth, kEditorHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+    glFinish();
+}
+
+// setupImGui() of the drawing thread
+static void open_context(Editor &editor)
+{
+    glfwMakeContextCurrent(editor.window);
+
+    if (editor.atlas == nullptr)
+        editor.atlas = IM_NEW(ImFontAtlas)();
+    editor.context = ImGui::CreateContext(editor.atlas);
+    ImGui::SetCurrentContext(editor.context);
+
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2((float)kEditorWidth, (float)kEditorHeight);
+    ImGui::StyleColorsDark();
+
+    ImGui_ImplGlfw_InitForOpenGL(editor.window, false);
+    ImGui_ImplOpenGL2_Init();
+
+    first_frame();
+}
+
+static void close_context(Editor &editor)
+{
+    glfwMakeContextCurrent(editor.window);
+    ImGui::SetCurrentContext(editor.context);
+
+    ImGui_ImplOpenGL2_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext(editor.context);
+    editor.context = nullptr;
+
+    glfwMakeContextCurrent(NULL);
+}
+
+static bool open_cold(Editor &editor)
+{
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    editor.window = glfwCreateWindow(kEditorWidth, kEditorHeight, "window_pool_check", nullptr, nullptr);
+    if (editor.window == nullptr)
+        return false;
+
+    open_context(editor);
+    return true;
+}
+
+// resumeImGui() of the drawing thread
+static void open_warm(Editor &editor)
+{
+    glfwMakeContextCurrent(editor.window);
+    ImGui::SetCurrentContext(editor.context);
+
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2((float)kEditorWidth, (float)kEditorHeight);
+    ImGui::StyleColorsDark();
+
+    first_frame();
+}
+
+// suspendImGui() of the drawing thread
+static void park_warm(Editor &editor)
+{
+    editor_imgui_reset(editor.context);
+    glfwMakeContextCurrent(NULL);
+}
+
+static void destroy(Editor &editor)
+{
+    if (editor.context != nullptr)
+        close_context(editor);
+
+    IM_DELETE(editor.atlas);
+    glfwDestroyWindow(editor.window);
+    editor = Editor();
+}
+
+static void benchmark()
+{
+    if (!glfwInit())
+    {
+        std::printf("No display, open benchmark skipped\n");
+        return;
+    }
+
+    const int opens = 20;
+    uint64_t coldNs = 0, warmWindowNs = 0, warmNs = 0;
+
+    for (int i = 0; i < opens; ++i)
+    {
+        Editor editor;
+
+        uint64_t startNs = monotonic_now_ns();
+        if (!open_cold(editor))
+        {
+            std::printf("No GL context, open benchmark skipped\n");
+            glfwTerminate();
+            return;
+        }
+        coldNs += monotonic_now_ns() - startNs;
+
+        if (i == 0)
+            std::printf("Open to first frame on %s, mean of %d:\n", (const char *)glGetString(GL_RENDERER), opens);
+
+        // Pool as it was before contexts were kept: window and atlas only
+        close_context(editor);
+        startNs = monotonic_now_ns();
+        open_context(editor);
+        warmWindowNs += monotonic_now_ns() - startNs;
+
+        // Pool as it is
+        park_warm(editor);
+        startNs = monotonic_now_ns();
+        open_warm(editor);
+        warmNs += monotonic_now_ns() - startNs;
+
+        destroy(editor);
+    }
+
+    std::printf("  cold         %8.3f ms\n", (double)coldNs / opens / 1e6);
+    std::printf("  warm window  %8.3f ms\n", (double)warmWindowNs / opens / 1e6);
+    std::printf("  warm         %8.3f ms\n", (double)warmNs / opens / 1e6);
+
+    glfwTerminate();
+}
+
+int main(int argc, char **argv)
+{
+    check_pool_bookkeeping();
+    check_imgui_reset();
+
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+        benchmark();
+
+    if (failures != 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("All checks passed\n");
+    return 0;
+}